@@ -53,6 +53,7 @@ static String_set_type abis;
 static bool append = false;
 static bool precomp_headers = false;
 static bool potdeps = false;
+static std::string ninja_name;
 
 // Current directory.
 static std::string gcwd;
@@ -71,10 +72,22 @@ static int add_object_dir (const char *dir)
 	return 0;
 }
 
+// The argument may be a list of ABIs separated by commas or spaces, as in
+// --abi "v2,v3,v4".
 static int add_abi (const char *abi)
 {
-	std::string s(abi);
-	abis.insert (s);
+	const char *sow = abi;
+
+	while (*sow) {
+		const char *eow = sow;
+		while (*eow && *eow != ',' && !isspace ((unsigned char)*eow)) {
+			++eow;
+		}
+		if (eow != sow) {
+			abis.insert (std::string (sow, eow));
+		}
+		sow = *eow ? eow + 1 : eow;
+	}
 	return 0;
 }
 
@@ -653,6 +666,7 @@ public:
 
 	void compute_mains ();
 	void dump_main_progs (std::ostream &os) const;
+	void dump_ninja (std::ostream &os) const;
 	void show_levels ();
 	void compute_and_show_libs () const;
 	void compute_target_pchs (std::ostream &os) const;
@@ -1188,6 +1202,149 @@ void Project::dump_main_progs (std::ostream &os) const
 
 
 
+// Convert a path of the makefile to ninja. References to make variables
+// become ${NAME} and the characters special for ninja are escaped.
+static std::string ninja_path (const std::string &s)
+{
+	std::string res;
+
+	for (size_t i = 0; i < s.size(); ++i) {
+		if (s[i] == '$' && i + 1 < s.size() && s[i + 1] == '(') {
+			size_t close = s.find (')', i);
+			if (close != s.npos) {
+				res += "${" + s.substr (i + 2, close - i - 2) + "}";
+				i = close;
+				continue;
+			}
+		}
+		if (s[i] == '$' || s[i] == ' ' || s[i] == ':') {
+			res += '$';
+		}
+		res += s[i];
+	}
+	return res;
+}
+
+
+// The name of the ninja rule for the object directory and ABI, as written
+// by ac_edit_ninja() of pelconf: cc_optimized, link_debug_pic, etc.
+static std::string ninja_rule (const char *kind, const std::string &dir, const std::string &abi)
+{
+	std::string res (kind);
+	std::string parts[2] = { dir == "." ? std::string() : dir, abi };
+
+	for (size_t i = 0; i < 2; ++i) {
+		if (parts[i].empty()) {
+			continue;
+		}
+		res += '_';
+		for (size_t j = 0; j < parts[i].size(); ++j) {
+			res += isalnum ((unsigned char)parts[i][j]) ? parts[i][j] : '_';
+		}
+	}
+	return res;
+}
+
+
+// Write the same targets as dump_single_deps() and dump_main_progs() as
+// ninja build statements. Must be called after compute_mains().
+void Project::dump_ninja (std::ostream &os) const
+{
+	// Sorted, so that the output does not change from run to run.
+	std::set<std::string> dirs (object_dirs.begin(), object_dirs.end());
+	std::set<std::string> sorted_abis (abis.begin(), abis.end());
+	std::vector<std::string> flavors (1);
+	std::string full_targets, headers, objs, out, tmp, pfx;
+
+	if (dirs.empty()) {
+		dirs.insert (".");
+	}
+	flavors.insert (flavors.end(), sorted_abis.begin(), sorted_abis.end());
+
+	os << "# Build statements generated by mkdeps. The rules are written by\n"
+	   << "# ac_edit_ninja() of pelconf.\n\n";
+
+	os << "incflags =";
+	for (auto di = search_dirs.begin(); di != search_dirs.end(); ++di) {
+		if (*di != ".") {
+			os << " -I" << ninja_path (*di);
+		}
+	}
+	os << "\n\n# Object files.\n";
+
+	for (auto i = files.begin(); i != files.end(); ++i) {
+		if (i->name == "precompiled") {
+			continue;
+		}
+		headers.clear();
+		for (auto di = i->deps.begin(); di != i->deps.end(); ++di) {
+			clean_file_name (di->c_str(), &tmp);
+			headers += " " + ninja_path (header_prefix + tmp);
+		}
+		for (auto db = dirs.begin(); db != dirs.end(); ++db) {
+			pfx = *db == "." ? std::string() : *db + "/";
+			for (auto fb = flavors.begin(); fb != flavors.end(); ++fb) {
+				out = pfx + i->name + (fb->empty() ? "" : "-" + *fb) + object_ext;
+				os << "build " << ninja_path (out) << ": " << ninja_rule ("cc", *db, *fb)
+				   << " " << ninja_path (i->full_name);
+				if (!headers.empty()) {
+					os << " |" << headers;
+				}
+				os << "\n";
+			}
+		}
+	}
+
+	os << "\n# Programs and libraries.\n";
+	for (auto db = dirs.begin(); db != dirs.end(); ++db) {
+		pfx = *db == "." ? std::string() : *db + "/";
+		for (auto i = mains.begin(); i != mains.end(); ++i) {
+			if (i->target == Not_target) {
+				continue;
+			}
+			for (auto fb = flavors.begin(); fb != flavors.end(); ++fb) {
+				std::string suffix = fb->empty() ? std::string() : "-" + *fb;
+				objs.clear();
+				for (auto li = i->deps.begin(); li != i->deps.end(); ++li) {
+					objs += " " + ninja_path (pfx + *li + suffix + object_ext);
+				}
+
+				if (i->target == Main_target) {
+					out = pfx + i->name + suffix + exe_ext;
+					os << "build " << ninja_path (out) << ": "
+					   << ninja_rule ("link", *db, *fb) << objs << "\n";
+				} else {
+					// As in dump_main_progs(): the static library is built
+					// from the plain objects and the shared library from the
+					// -pic objects, or from the plain ones without --abi pic.
+					tmp = starts_with (i->name, lib_prefix) ? i->name : lib_prefix + i->name;
+					if (fb->empty()) {
+						out = pfx + tmp + ar_suffix;
+						os << "build " << ninja_path (out) << ": "
+						   << ninja_rule ("ar", *db, "") << objs << "\n";
+						full_targets += " $\n    " + ninja_path (out);
+						if (abis.find ("pic") != abis.end()) {
+							continue;
+						}
+						out = pfx + tmp + lib_suffix;
+					} else if (*fb == "pic") {
+						out = pfx + tmp + lib_suffix;
+					} else {
+						out = pfx + tmp + suffix + lib_suffix;
+					}
+					os << "build " << ninja_path (out) << ": "
+					   << ninja_rule ("so", *db, "") << objs << "\n";
+				}
+				full_targets += " $\n    " + ninja_path (out);
+			}
+		}
+	}
+
+	os << "\nbuild full_targets: phony" << full_targets << "\n";
+}
+
+
+
 void Project::compute_target_pchs (std::ostream &os) const
 {
 	Mains_type::const_iterator i = mains.begin ();
@@ -1619,12 +1776,13 @@ static void show_help()
 	std::cout << "-a <suffix>         set the suffix for static libraries\n";
 	std::cout << "-f <makefile>       set the name of the makefile to modify\n";
 	std::cout << "--odir <directory>  add an object directory\n";
-	std::cout << "--abi <abiname>     add an additional ABI\n";
+	std::cout << "--abi <abinames>    add additional ABIs, separated by commas\n";
 	std::cout << "--hpfx <prefix>     set the prefix to prepend to header names\n";
 	std::cout << "--append            append to makefile instead of modifying\n";
 	std::cout << "--pch               use precompiled headers for each file in gcc\n";
 	std::cout << "--tch               use precompiled headers for each target in gcc\n";
 	std::cout << "--potdeps           generate dependencies for C++ POT files\n";
+	std::cout << "--ninja <file>      also write the build statements for ninja to file\n";
 
 	std::cout << "It will scan the source files, check the corresponding header files\n";
 	std::cout << "and compute the dependencies. It understands #ifdefs.\n";
@@ -1677,6 +1835,9 @@ static int real_main (int argc, char **argv)
 	if (hasopt_long (&argc, argv, "--potdeps")) {
 		potdeps = true;
 	}
+	if (hasopt_long (&argc, argv, "--ninja", &val)) {
+		ninja_name = val;
+	}
 
 	while ((opt = hasopt(&argc, argv, "hI:vdo:e:a:f:", &val)) > 0) {
 		switch (opt) {
@@ -1757,6 +1918,15 @@ static int real_main (int argc, char **argv)
 		project.compute_target_pchs (mkfile);
 	}
 
+	if (!ninja_name.empty()) {
+		std::ofstream ninja (ninja_name.c_str());
+		if (!ninja.good()) {
+			std::cerr << "mkdeps: can't open file '" << ninja_name << "'\n";
+			return 1;
+		}
+		project.dump_ninja (ninja);
+	}
+
 	if (verbose) {
 		project.show_levels ();
 	}
@@ -7,6 +7,7 @@
 
 int main (int argc, char **argv)
 {
+	ac_add_option_info ("ninja", "Also write build.ninja from build.ninja.in, written by mkdeps --ninja");
 	ac_init (".cpp", argc, argv, 1);
 	ac_check_each_header_sequence ("unistd.h, sys/mman.h", NULL);
 	ac_has_func_lib ("sys/time.h", NULL, "gettimeofday", NULL);
@@ -169,6 +170,9 @@ int main (int argc, char **argv)
 
 	ac_config_out ("config.h", "PELTK_BASE");
 	ac_edit_makefile ("makefile.in", "makefile");
+	if (ac_has_feature ("ninja", NULL, 0)) {
+		ac_edit_ninja ("build.ninja.in", "build.ninja");
+	}
 	ac_create_pc_file ("peltk-base", "General C++ utilies library");
 	ac_finish ();
 
@@ -108,6 +108,13 @@ static int aci_warn_makevars = 0;
 /* Did the makevar file specify the TARGET_ARCH */
 static int aci_target_arch_given = 0;
 
+/* The name of the configuration program, used to run it again from
+   build.ninja. */
+static const char *aci_progname = "pelconf";
+
+/* The configuration header written by ac_config_out(). */
+static char aci_config_name[FILENAME_MAX] = "";
+
 /* Does the available version of make follow MS-DOS conventions? */
 static int aci_dos_make = 0;
 
@@ -476,6 +483,9 @@ static sbuf_t aci_additional_libs;
 /* The flags used when testing for features. */
 static sbuf_t aci_testing_flags;
 
+/* The flags used only when testing for features by linking. */
+static sbuf_t aci_link_testing_flags;
+
 
 
 
@@ -1276,6 +1286,8 @@ static int aci_can_compile_link (const char *src, const char *cflags,
 	sbufformat (&sb, 1, "%s %s", aci_compile_cmd, aci_werror);
 	sbufformat (&sb, 0, " %s%s ", aci_test_file, aci_source_extension);
 	aci_add_cflags (&sb, cflags);
+	sbufcat (&sb, sbufchars (&aci_link_testing_flags));
+	sbufcat (&sb, " ");
 	if (verbatim) {
 		sbufcat (&sb, libs);
 	} else {
@@ -2120,6 +2132,23 @@ int ac_has_file (const char *name)
 }
 
 
+/* Check if the program "prog" can be run in the compilation environment
+   by running it with the arguments "args". */
+static int aci_has_program (const char *prog, const char *args)
+{
+	sbuf_t sb;
+	int result;
+
+	sbufinit (&sb);
+	sbufformat (&sb, 1, "%s %s", prog, args);
+	result = aci_run_silent (sbufchars (&sb)) == 0;
+	printf ("Has the program %s: %s\n", prog, aci_noyes[result]);
+	fflush (stdout);
+	sbuffree (&sb);
+	return result;
+}
+
+
 
 /* Detects the size of a type without actually running the output (may be
    useful for cross compilers. It will include the files listed in
@@ -3495,6 +3524,99 @@ void aci_check_att_format (void)
 }
 
 
+/* Define macro "name" as "def" if the check passed and as "fallback"
+   otherwise. */
+static void aci_define_macro (const char *name, int passed, const char *def,
+                              const char *fallback)
+{
+	sbuf_t sb;
+
+	sbufinit (&sb);
+	sbufformat (&sb, 1, "#define %s%s %s", aci_macro_prefix, name, passed ? def : fallback);
+	ac_add_code (sbufchars (&sb), 1);
+	sbuffree (&sb);
+}
+
+
+/* Define the annotations for hot paths. They expand to nothing, or to the
+   plain expression, if the compiler does not support them:
+   LIKELY(x), UNLIKELY(x), PREFETCH(p,rw,locality), ASSUME_ALIGNED(p,n),
+   UNREACHABLE(), ASSUME(cond), RESTRICT and CONSTANT_P(x), the statement
+   attributes GCCA_LIKELY and GCCA_UNLIKELY and the function attributes
+   GCCA_HOT, GCCA_COLD, GCCA_FLATTEN, GCCA_ALWAYS_INLINE and GCCA_NOINLINE.
+   Return the number of annotations that are supported. */
+int ac_check_hot_path_macros (void)
+{
+	int res, count = 0;
+
+	res = ac_does_compile ("Has __builtin_expect()",
+	        "int f (int x) { if (__builtin_expect (!!(x), 1)) return 1; return 0; }\n",
+	        NULL, "BUILTIN_EXPECT");
+	aci_define_macro ("LIKELY(x)", res, "__builtin_expect (!!(x), 1)", "(x)");
+	aci_define_macro ("UNLIKELY(x)", res, "__builtin_expect (!!(x), 0)", "(x)");
+	count += res;
+
+	res = ac_does_compile ("Has the [[likely]] attribute",
+	        "int f (int x) { if (x) [[likely]] { return 1; } else [[unlikely]] { return 0; } }\n",
+	        NULL, "CXX_LIKELY");
+	aci_define_macro ("GCCA_LIKELY", res, "[[likely]]", "");
+	aci_define_macro ("GCCA_UNLIKELY", res, "[[unlikely]]", "");
+	count += res;
+
+	res = ac_does_compile ("Has __builtin_prefetch()",
+	        "void f (const int *p) { __builtin_prefetch (p, 0, 3); __builtin_prefetch (p + 16, 1, 0); }\n",
+	        NULL, "BUILTIN_PREFETCH");
+	aci_define_macro ("PREFETCH(p,rw,locality)", res, "__builtin_prefetch ((p), (rw), (locality))",
+	                  "((void) (p))");
+	count += res;
+
+	res = ac_does_compile ("Has __builtin_assume_aligned()",
+	        "int f (int *p) { int *q = (int *) __builtin_assume_aligned (p, 64); return *q; }\n",
+	        NULL, "BUILTIN_ASSUME_ALIGNED");
+	aci_define_macro ("ASSUME_ALIGNED(p,n)", res, "__builtin_assume_aligned ((p), (n))",
+	                  "((void *) (p))");
+	count += res;
+
+	res = ac_does_compile ("Has __builtin_unreachable()",
+	        "int f (int x) { if (x > 1) return x; __builtin_unreachable (); }\n",
+	        NULL, "BUILTIN_UNREACHABLE");
+	aci_define_macro ("UNREACHABLE()", res, "__builtin_unreachable ()", "((void) 0)");
+	count += res;
+
+	/* Prefer the standard attribute, then the builtin of clang and finally
+	   tell the compiler that the other branch cannot be reached. */
+	if (ac_does_compile ("Has the [[assume]] attribute",
+	        "int f (int x) { [[assume (x > 0)]]; return x; }\n", NULL, "CXX_ASSUME")) {
+		aci_define_macro ("ASSUME(cond)", 1, "[[assume (cond)]]", "");
+		++count;
+	} else if (ac_does_compile ("Has __builtin_assume()",
+	        "int f (int x) { __builtin_assume (x > 0); return x; }\n", NULL, "BUILTIN_ASSUME")) {
+		aci_define_macro ("ASSUME(cond)", 1, "__builtin_assume (cond)", "");
+		++count;
+	} else {
+		aci_define_macro ("ASSUME(cond)", res, "do { if (!(cond)) __builtin_unreachable (); } while (0)",
+		                  "((void) 0)");
+	}
+
+	/* aci_check_restrict_keyword() has already made restrict available. */
+	aci_define_macro ("RESTRICT", 1, "restrict", "");
+
+	res = ac_does_compile ("Has __builtin_constant_p()",
+	        "int f (int x) { return __builtin_constant_p (x) ? 1 : 2; }\n",
+	        NULL, "BUILTIN_CONSTANT_P");
+	aci_define_macro ("CONSTANT_P(x)", res, "__builtin_constant_p (x)", "0");
+	count += res;
+
+	count += ac_has_func_attribute ("hot", "HOT", 0, 0, att_gnu);
+	count += ac_has_func_attribute ("cold", "COLD", 0, 0, att_gnu);
+	count += ac_has_func_attribute ("flatten", "FLATTEN", 0, 0, att_gnu);
+	count += ac_has_func_attribute ("always_inline", "ALWAYS_INLINE", 0, 0, att_gnu);
+	count += ac_has_func_attribute ("noinline", "NOINLINE", 0, 0, att_gnu);
+
+	return count;
+}
+
+
 
 /* See if the compiler supports the compilation flag "flag". If it does set
    the makefile variable "makevar" to "flag".
@@ -3515,236 +3637,2132 @@ int ac_has_compiler_flag (const char *flag, const char *makevar)
 }
 
 
-/* Check for the presence of ssize_t and typedef it otherwise. */
-static void aci_check_ssize (void)
-{
-	if (aci_can_compile ("#include <unistd.h>\nssize_t x;\n", "")) {
-		ac_add_code ("#include <unistd.h>", 1);
-	} else {
-		sbuf_t sb;
-		int szu = aci_check_sizeof ("stddef.h", "", "size_t", 0);
-		int szi = aci_check_sizeof ("stddef.h", "", "ptrdiff_t", 0);
-		if (szu == 0) {
-			printf ("could not find the size of size_t\n");
-			exit (1);
+/* Instruction set extensions. Each one is tried with the candidate flags
+   in order. The flags of the first candidate that compiles go to the
+   makefile variable ISA_<name>_CFLAGS. */
+static const struct {
+	const char *name;
+	const char *flags[2];
+	const char *src;
+} aci_isa_checks[] = {
+	{ "SSE4_2", { "-msse4.2", NULL },
+	  "#include <nmmintrin.h>\n"
+	  "int main (void) { return (int) _mm_crc32_u32 (0, 42); }\n" },
+	{ "AVX2", { "-mavx2", NULL },
+	  "#include <immintrin.h>\n"
+	  "int main (void) {\n"
+	  "    __m256i a = _mm256_set1_epi32 (1);\n"
+	  "    return _mm256_movemask_epi8 (_mm256_add_epi32 (a, a));\n"
+	  "}\n" },
+	{ "AVX512F", { "-mavx512f", NULL },
+	  "#include <immintrin.h>\n"
+	  "int main (void) {\n"
+	  "    __m512i a = _mm512_set1_epi32 (1);\n"
+	  "    return _mm512_reduce_add_epi32 (_mm512_add_epi32 (a, a));\n"
+	  "}\n" },
+	{ "BMI2", { "-mbmi2", NULL },
+	  "#include <immintrin.h>\n"
+	  "int main (void) { return (int) _pdep_u32 (3u, 0xF0u); }\n" },
+	{ "FMA", { "-mfma", NULL },
+	  "#include <immintrin.h>\n"
+	  "int main (void) {\n"
+	  "    __m256 a = _mm256_set1_ps (1.0f);\n"
+	  "    return (int) _mm256_cvtss_f32 (_mm256_fmadd_ps (a, a, a));\n"
+	  "}\n" },
+	{ "NEON", { "-mfpu=neon", "" },
+	  "#include <arm_neon.h>\n"
+	  "int main (void) {\n"
+	  "    int32x4_t a = vdupq_n_s32 (1);\n"
+	  "    return vgetq_lane_s32 (vaddq_s32 (a, a), 0);\n"
+	  "}\n" },
+	{ "SVE", { "-march=armv8-a+sve", NULL },
+	  "#include <arm_sve.h>\n"
+	  "int main (void) { return (int) svcntb (); }\n" }
+};
+
+
+/* Targets used when checking for function multiversioning. */
+static const char aci_isa_targets[] =
+	"#if defined(__x86_64__) || defined(__i386__)\n"
+	"#define ISA_TARGET \"avx2\"\n"
+	"#define ISA_CLONES \"avx2\", \"default\"\n"
+	"#elif defined(__aarch64__)\n"
+	"#define ISA_TARGET \"+crc\"\n"
+	"#define ISA_CLONES \"sve\", \"default\"\n"
+	"#else\n"
+	"#error no known targets\n"
+	"#endif\n";
+
+
+/* Check which instruction set extensions can be used by the compiler, if
+   functions can be compiled for specific targets and if the CPU can be
+   queried at run time. Define HAVE_ISA_<name> for each extension and set
+   the makefile variable ISA_<name>_CFLAGS with the flags that enable it.
+   Return the number of extensions found. */
+int ac_check_isa (void)
+{
+	size_t i, j;
+	int res, count = 0;
+	const char *flags;
+	sbuf_t tag, cmt;
+
+	sbufinit (&tag);
+	sbufinit (&cmt);
+
+	for (i = 0; i < sizeof aci_isa_checks / sizeof aci_isa_checks[0]; ++i) {
+		res = 0;
+		flags = NULL;
+		for (j = 0; j < 2 && aci_isa_checks[i].flags[j] != NULL && !res; ++j) {
+			flags = aci_isa_checks[i].flags[j];
+			res = aci_can_compile (aci_isa_checks[i].src, flags);
 		}
-		if (szu == szi) {
-			ac_add_code ("typedef ptrdiff_t ssize_t;", 1);
+
+		sbufformat (&cmt, 1, "Has the %s instruction set extension", aci_isa_checks[i].name);
+		sbufformat (&tag, 1, "ISA_%s", aci_isa_checks[i].name);
+		ac_add_flag (sbufchars (&tag), sbufchars (&cmt), res);
+		if (res) {
+			sbufcat (&tag, "_CFLAGS");
+			ac_set_var (sbufchars (&tag), flags);
+			printf ("%s: yes (%s)\n", sbufchars (&cmt), *flags ? flags : "always");
+			++count;
 		} else {
-			sbufinit (&sb);
-			sbufformat (&sb, 0, "typedef int_least%d_t ssize_t;", szu * 8);
-			ac_add_code (sbufchars (&sb), 1);
-			sbuffree (&sb);
+			printf ("%s: no\n", sbufchars (&cmt));
 		}
+		fflush (stdout);
 	}
-}
 
+	sbufcpy (&cmt, aci_isa_targets);
+	sbufcat (&cmt, "__attribute__((target(ISA_TARGET))) int foo (void) { return 1; }\n"
+	               "int main (void) { return foo (); }\n");
+	ac_does_compile_and_link ("Has __attribute__((target()))", sbufchars (&cmt),
+	                          NULL, NULL, "ISA_TARGET_ATTRIBUTE");
+
+	sbufcpy (&cmt, aci_isa_targets);
+	sbufcat (&cmt, "__attribute__((target_clones(ISA_CLONES))) int foo (void) { return 1; }\n"
+	               "int main (void) { return foo (); }\n");
+	ac_does_compile_and_link ("Has __attribute__((target_clones()))", sbufchars (&cmt),
+	                          NULL, NULL, "ISA_TARGET_CLONES");
+
+	ac_does_compile_and_link ("Has __builtin_cpu_supports()",
+	        "#if defined(__x86_64__) || defined(__i386__)\n"
+	        "#define ISA_FEATURE \"avx2\"\n"
+	        "#else\n"
+	        "#define ISA_FEATURE \"sve\"\n"
+	        "#endif\n"
+	        "int main (void) {\n"
+	        "    __builtin_cpu_init ();\n"
+	        "    return __builtin_cpu_supports (ISA_FEATURE) ? 1 : 0;\n"
+	        "}\n",
+	        NULL, NULL, "ISA_CPU_SUPPORTS");
+
+	sbuffree (&tag);
+	sbuffree (&cmt);
+	return count;
+}
+
+
+int ac_has_pkg_config (void);
+int ac_pkg_config_query (const char *package, sbuf_t *cflags, sbuf_t *libs);
+int ac_has_func_pkg_config_tag (const char *includes, const char *cflags,
+        const char *func, const char *package, const char *tag);
+int ac_run_manifest (const char *fname);
+
+/* Linux I/O interfaces. Each source must compile and link. */
+#define ACI_GNU_SOURCE "#ifndef _GNU_SOURCE\n#define _GNU_SOURCE 1\n#endif\n"
+static const struct {
+	const char *tag;
+	const char *comment;
+	const char *src;
+} aci_io_checks[] = {
+	{ "IO_URING_SETUP", "Has the io_uring_setup system call",
+	  ACI_GNU_SOURCE
+	  "#include <linux/io_uring.h>\n#include <sys/syscall.h>\n#include <unistd.h>\n"
+	  "int main (void) { struct io_uring_params p = { 0 };\n"
+	  "    return (int) syscall (__NR_io_uring_setup, 1, &p); }\n" },
+	{ "COPY_FILE_RANGE", "Has copy_file_range()",
+	  ACI_GNU_SOURCE
+	  "#include <unistd.h>\n"
+	  "int main (void) { return (int) copy_file_range (0, 0, 1, 0, 1, 0); }\n" },
+	{ "SENDFILE", "Has sendfile()",
+	  "#include <sys/sendfile.h>\n"
+	  "int main (void) { return (int) sendfile (1, 0, 0, 1); }\n" },
+	{ "SPLICE", "Has splice()",
+	  ACI_GNU_SOURCE
+	  "#include <fcntl.h>\n"
+	  "int main (void) { return (int) splice (0, 0, 1, 0, 1, SPLICE_F_MOVE); }\n" },
+	{ "VMSPLICE", "Has vmsplice()",
+	  ACI_GNU_SOURCE
+	  "#include <fcntl.h>\n#include <sys/uio.h>\n"
+	  "int main (void) { struct iovec v = { 0, 0 };\n"
+	  "    return (int) vmsplice (1, &v, 1, SPLICE_F_GIFT); }\n" },
+	{ "O_DIRECT", "Has O_DIRECT",
+	  ACI_GNU_SOURCE
+	  "#include <fcntl.h>\n"
+	  "int main (void) { return open (\"x\", O_RDONLY | O_DIRECT); }\n" },
+	{ "POSIX_FADVISE", "Has posix_fadvise()",
+	  ACI_GNU_SOURCE
+	  "#include <fcntl.h>\n"
+	  "int main (void) { return posix_fadvise (0, 0, 0, POSIX_FADV_SEQUENTIAL); }\n" },
+	{ "READAHEAD", "Has readahead()",
+	  ACI_GNU_SOURCE
+	  "#include <fcntl.h>\n"
+	  "int main (void) { return (int) readahead (0, 0, 4096); }\n" },
+	{ "PREADV2_NOWAIT", "Has preadv2() with RWF_NOWAIT",
+	  ACI_GNU_SOURCE
+	  "#include <sys/uio.h>\n"
+	  "int main (void) { char c; struct iovec v; v.iov_base = &c; v.iov_len = 1;\n"
+	  "    return (int) preadv2 (0, &v, 1, 0, RWF_NOWAIT); }\n" },
+	{ "FALLOCATE", "Has fallocate()",
+	  ACI_GNU_SOURCE
+	  "#include <fcntl.h>\n"
+	  "int main (void) { return fallocate (0, FALLOC_FL_KEEP_SIZE, 0, 4096); }\n" }
+};
 
-/* Check for the unicode types char16_t and char32_t. */
-static void aci_check_char32 (void)
+/* Result of each check of aci_io_checks. */
+enum {
+	aci_io_uring_setup, aci_io_copy_file_range, aci_io_sendfile, aci_io_splice,
+	aci_io_vmsplice, aci_io_o_direct, aci_io_posix_fadvise, aci_io_readahead,
+	aci_io_preadv2_nowait, aci_io_fallocate, aci_io_count
+};
+
+
+static int aci_replace_if_changed (const char *tmpname, const char *name);
+
+/* Write the header with the wrappers for the I/O functions. The wrappers
+   use the best function found and fall back to portable code. */
+static void aci_write_io_header (const char *header, const int *have)
 {
-	sbuf_t sb;
-	ac_has_type ("", NULL, "char32_t");
-	ac_has_type_tag ("uchar.h", NULL, "char32_t", "CHAR32_T_IN_UCHAR_H");
-	ac_has_headers ("cuchar", NULL);
+	FILE *f;
+	sbuf_t tmpname;
 
-	/* Ensure that wchar_t is always distinct from char16_t and char32_t.
-	   This is what the C++11 standard says.
-	*/
+	sbufinit (&tmpname);
+	sbufformat (&tmpname, 1, "%s.tmp", header);
+	f = fopen (sbufchars (&tmpname), "w");
+	if (f == NULL) {
+		fprintf (stderr, "ERROR: could not create the header %s\n", header);
+		exit (EXIT_FAILURE);
+	}
 
-	sbufinit (&sb);
-	sbufcpy (&sb,
-	        "#ifndef HAVE_CHAR32_T\n"
-			"  #ifdef CHAR32_T_IN_UCHAR_H\n"
-			"    #include <uchar.h>\n"
-			"  #elif defined(HAVE_CUCHAR)\n"
-			"    #include <cuchar>\n"
-			"  #elif !defined(__STDC_UTF_32__)\n");
+	fprintf (f, "/* Automatically generated by the pelconf program, do not edit. */\n"
+	            "/* Include it before any other system header. */\n"
+	            "#ifndef PELCONF_IO_H\n#define PELCONF_IO_H\n\n"
+	            "#ifndef _GNU_SOURCE\n#define _GNU_SOURCE 1\n#endif\n\n"
+	            "#include <sys/types.h>\n#include <fcntl.h>\n#include <unistd.h>\n"
+	            "#include <errno.h>\n");
+	if (have[aci_io_sendfile]) {
+		fprintf (f, "#include <sys/sendfile.h>\n");
+	}
+	if (have[aci_io_preadv2_nowait] || have[aci_io_vmsplice]) {
+		fprintf (f, "#include <sys/uio.h>\n");
+	}
+	fprintf (f, "\n#if defined(__cplusplus) || (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L)\n"
+	            "#define PELCONF_IO_INLINE static inline\n"
+	            "#else\n"
+	            "#define PELCONF_IO_INLINE static __inline__\n"
+	            "#endif\n\n");
 
-	sbufcat (&sb,
-	        "    typedef uint_least16_t char16_t;\n"
-			"    typedef uint_least32_t char32_t;\n");
+	fprintf (f, "/* Flag for open() that bypasses the page cache, 0 if not available. */\n");
+	if (have[aci_io_o_direct]) {
+		fprintf (f, "#define PELCONF_O_DIRECT O_DIRECT\n\n");
+	} else {
+		fprintf (f, "#define PELCONF_O_DIRECT 0\n\n");
+	}
 
+	fprintf (f, "/* Copy up to len bytes from the current position of in to out. */\n"
+	            "PELCONF_IO_INLINE ssize_t pelconf_copy_file_range (int in, int out, size_t len)\n{\n");
+	if (have[aci_io_copy_file_range]) {
+		fprintf (f, "\treturn copy_file_range (in, NULL, out, NULL, len, 0);\n");
+	} else if (have[aci_io_sendfile]) {
+		fprintf (f, "\treturn sendfile (out, in, NULL, len);\n");
+	} else {
+		fprintf (f, "\tchar buf[65536];\n"
+		            "\tssize_t n = read (in, buf, len < sizeof buf ? len : sizeof buf);\n"
+		            "\treturn n > 0 ? write (out, buf, (size_t) n) : n;\n");
+	}
+	fprintf (f, "}\n\n");
 
-	sbufcat (&sb,
-	        "    #define __STDC_UTF_32__\n"
-			"    #define __STDC_UTF_16__\n"
-			"  #endif\n"
-			"#endif\n\n");
+	fprintf (f, "/* Tell the kernel that fd will be read sequentially. */\n"
+	            "PELCONF_IO_INLINE int pelconf_fadvise_sequential (int fd)\n{\n");
+	if (have[aci_io_posix_fadvise]) {
+		fprintf (f, "\treturn posix_fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL);\n");
+	} else {
+		fprintf (f, "\t(void) fd;\n\treturn 0;\n");
+	}
+	fprintf (f, "}\n\n");
 
-	ac_add_code (sbufchars (&sb), 1);
+	fprintf (f, "/* Start reading the given range of fd into the page cache. */\n"
+	            "PELCONF_IO_INLINE int pelconf_readahead (int fd, off_t offset, size_t len)\n{\n");
+	if (have[aci_io_readahead]) {
+		fprintf (f, "\treturn (int) readahead (fd, offset, len);\n");
+	} else if (have[aci_io_posix_fadvise]) {
+		fprintf (f, "\treturn posix_fadvise (fd, offset, (off_t) len, POSIX_FADV_WILLNEED);\n");
+	} else {
+		fprintf (f, "\t(void) fd; (void) offset; (void) len;\n\treturn 0;\n");
+	}
+	fprintf (f, "}\n\n");
+
+	fprintf (f, "/* Read only if the data is already in the page cache. Otherwise fail\n"
+	            "   with EAGAIN, so that the caller can move the read to another thread. */\n"
+	            "PELCONF_IO_INLINE ssize_t pelconf_pread_nowait (int fd, void *buf, size_t len, off_t offset)\n{\n");
+	if (have[aci_io_preadv2_nowait]) {
+		fprintf (f, "\tstruct iovec v;\n"
+		            "\tv.iov_base = buf;\n"
+		            "\tv.iov_len = len;\n"
+		            "\treturn preadv2 (fd, &v, 1, offset, RWF_NOWAIT);\n");
+	} else {
+		fprintf (f, "\t(void) fd; (void) buf; (void) len; (void) offset;\n"
+		            "\terrno = EAGAIN;\n"
+		            "\treturn -1;\n");
+	}
+	fprintf (f, "}\n\n");
 
-	if (ac_does_compile ("Has U\"text\" support",
-	                      "const void *p = U\"text\";\n",
-	                      NULL, "NATIVE_U_ESCAPE")) {
-		ac_add_code ("#ifndef UCS\n#define UCS(X) U##X\n#endif\n", 1);
-		ac_add_code ("#ifndef __cpp_unicode_literals\n"
-				 "  #define __cpp_unicode_literals 200710\n"
-				 "#endif\n", 1);
-	} else if (ac_get_sizeof ("stddef.h", NULL, "wchar_t") == 4) {
-		ac_add_code ("#ifndef UCS\n#define UCS(X) ((const char32_t*)L##X)\n#endif\n", 1);
+	fprintf (f, "/* Reserve the disk space of the given range without changing the size\n"
+	            "   of the file. The reservation is only a hint where not supported. */\n"
+	            "PELCONF_IO_INLINE int pelconf_fallocate (int fd, off_t offset, off_t len)\n{\n");
+	if (have[aci_io_fallocate]) {
+		fprintf (f, "\treturn fallocate (fd, FALLOC_FL_KEEP_SIZE, offset, len);\n");
 	} else {
-		printf ("can't find a suitable definition for UCS-4 encoded string literals.\n");
+		fprintf (f, "\t(void) fd; (void) offset; (void) len;\n\treturn 0;\n");
 	}
+	fprintf (f, "}\n\n#endif\n");
+	fclose (f);
 
-	sbuffree (&sb);
-	fflush (stdout);
+	if (aci_replace_if_changed (sbufchars (&tmpname), header)) {
+		printf ("Writing the I/O header '%s'\n", header);
+	} else {
+		printf ("'%s' is unchanged\n", header);
+	}
+	sbuffree (&tmpname);
 }
 
 
-static void aci_check_c11_atomics (void)
+/* Check for the fast I/O interfaces of Linux. If header is not NULL then
+   also write it with wrappers that use the best interface available.
+   Return the number of interfaces found. */
+int ac_check_io (const char *header)
 {
-	ac_does_compile ("Has native support for atomic_size_t",
-	      "#include <stdatomic.h>\natomic_size_t x = ATOMIC_INIT_VAR(0);\n", NULL, "ATOMIC_SIZE_T");
+	int have[aci_io_count];
+	int i, count = 0;
+	sbuf_t cflags, libs;
 
-	ac_does_compile ("Has atomic_load_explicit",
-	      "#include <stdatomic.h>\n"
-		  "atomic_int x = ATOMIC_INIT_VAR(0);\n"
-		  "size_t foo (void) { return atomic_load_explicit (&x, memory_order_acquire); }\n",
-		  NULL, "ATOMIC_LOAD_EXPLICIT");
-
-	ac_does_compile ("Has atomic_store_explicit",
-	      "#include <stdatomic.h>\n"
-		  "atomic_int x = ATOMIC_INIT_VAR(0);\n"
-		  "void foo (size_t v) { atomic_store_explicit (&x, v, memory_order_release); }\n",
-		  NULL, "ATOMIC_STORE_EXPLICIT");
+	for (i = 0; i < aci_io_count; ++i) {
+		have[i] = ac_does_compile_and_link (aci_io_checks[i].comment, aci_io_checks[i].src,
+		                                    NULL, NULL, aci_io_checks[i].tag);
+		count += have[i];
+	}
+	/* The package is liburing but the library is -luring. */
+	sbufinit (&cflags);
+	sbufinit (&libs);
+	if (ac_has_pkg_config () && ac_pkg_config_query ("liburing", &cflags, &libs) == 0) {
+		count += ac_has_func_pkg_config_tag ("liburing.h", NULL, "io_uring_queue_init", "liburing", "LIBURING");
+	} else {
+		count += ac_has_func_lib_tag ("liburing.h", NULL, "io_uring_queue_init", "uring", 0, "LIBURING");
+	}
+	sbuffree (&cflags);
+	sbuffree (&libs);
 
-	ac_does_compile ("Has atomic_exchange_explicit",
-	      "#include <stdatomic.h>\n"
-		  "atomic_int x = ATOMIC_INIT_VAR(0);\n"
-		  "size_t foo (size_t v) { return atomic_exchange_explicit (&x, v, memory_order_acq_rel); }\n",
-		  NULL, "ATOMIC_EXCHANGE_EXPLICIT");
+	if (header != NULL) {
+		aci_write_io_header (header, have);
+	}
+	return count;
+}
 
-	ac_does_compile ("Has atomic_compare_exchange_weak_explicit",
-	      "#include <stdatomic.h>\n"
-		  "atomic_int = ATOMIC_INIT_VAR(0);\n"
-		  "int foo (size_t v) { \n"
-		  "   return atomic_compare_exchange_weak_explicit (&x, 1, v, memory_order_acq_rel, memory_order_relaxed);\n"
-		  "}\n",
-		  NULL, "ATOMIC_COMPARE_EXCHANGE_WEAK_EXPLICIT");
 
-	ac_does_compile ("Has atomic_fetch_add_explicit",
-	      "#include <stdatomic.h>\n"
-		  "atomic_int x = ATOMIC_INIT_VAR(0);\n"
-		  "size_t foo (size_t v) { \n"
-		  "   return atomic_fetch_add_explicit (&x, v, memory_order_relaxed);\n"
-		  "}\n",
-		  NULL, "ATOMIC_FETCH_SUB_EXPLICIT");
+/* Do not run the programs built by the tests, as when cross compiling. */
+static int aci_no_run = 0;
 
-	ac_does_compile ("Has atomic_fetch_sub_explicit",
-	      "#include <stdatomic.h>\n"
-		  "atomic_int x = ATOMIC_INIT_VAR(0);\n"
-		  "size_t foo (size_t v) { \n"
-		  "   return atomic_fetch_sub_explicit (&x, v, memory_order_acq_rel);\n"
-		  "}\n",
-		  NULL, "ATOMIC_FETCH_SUB_EXPLICIT");
+/* Topology of the CPU given with --target-cpu-topology or NULL. */
+static const char *aci_target_cpu_topology = NULL;
 
 
-	ac_does_compile ("Has std::atomic_load_explicit",
-	      "#include <atomic>\n"
-		  "std::atomic_int x = ATOMIC_INIT_VAR(0);\n"
-		  "size_t foo (void) { return std::atomic_load_explicit (&x, std::memory_order_acquire); }\n",
-		  NULL, "CXX_ATOMIC_LOAD_EXPLICIT");
+/* Read the first line of the file "name" into buf, without the newline.
+   Return nonzero on success. */
+static int aci_read_line_file (const char *name, char *buf, size_t n)
+{
+	FILE *f;
+	char *cp;
 
-	ac_does_compile ("Has std::atomic_store_explicit",
-	      "#include <atomic>\n"
-		  "std::atomic_int x = ATOMIC_INIT_VAR(0);\n"
-		  "void foo (size_t v) { std::atomic_store_explicit (&x, v, std::memory_order_release); }\n",
-		  NULL, "CXX_ATOMIC_STORE_EXPLICIT");
+	f = fopen (name, "r");
+	if (f == NULL) {
+		return 0;
+	}
+	if (fgets (buf, (int) n, f) == NULL) {
+		fclose (f);
+		return 0;
+	}
+	fclose (f);
+	cp = strchr (buf, '\n');
+	if (cp) *cp = 0;
+	return 1;
+}
 
-	ac_does_compile ("Has std::atomic_exchange_explicit",
-	      "#include <atomic>\n"
-		  "std::atomic_int x = ATOMIC_INIT_VAR(0);\n"
-		  "size_t foo (size_t v) { return std::atomic_exchange_explicit (&x, v, std::memory_order_acq_rel); }\n",
-		  NULL, "CXX_ATOMIC_EXCHANGE_EXPLICIT");
 
-	ac_does_compile ("Has std::atomic_compare_exchange_weak_explicit",
-	      "#include <atomic>\n"
-		  "std::atomic_int x = ATOMIC_INIT_VAR(0);\n"
-		  "int foo (size_t v) { \n"
-		  "   return std::atomic_compare_exchange_weak_explicit (&x, 1, v, std::memory_order_acq_rel, std::memory_order_relaxed);\n"
-		  "}\n",
-		  NULL, "CXX_ATOMIC_COMPARE_EXCHANGE_WEAK_EXPLICIT");
+/* Build the program src and run it. Return nonzero if it ran successfully
+   and the first line of its output is in buf. */
+static int aci_build_and_run (const char *src, const char *flags, const char *libs,
+                              char *buf, size_t n)
+{
+	return aci_can_compile_link (src, flags, libs, 0) &&
+	       aci_run_silent (aci_have_windows ? "a.exe" : "./a.out") == 0 &&
+	       aci_read_line_file (aci_stdout_dummy, buf, n);
+}
 
-	ac_does_compile ("Has std::atomic_fetch_add_explicit",
-	      "#include <atomic>\n"
-		  "std::atomic_int x = 0;\n"
-		  "size_t foo (size_t v) { \n"
-		  "   return std::atomic_fetch_add_explicit (&x, v, std::memory_order_relaxed);\n"
-		  "}\n",
-		  NULL, "CXX_ATOMIC_FETCH_ADD_EXPLICIT");
 
-	ac_does_compile ("Has std::atomic_fetch_sub_explicit",
-	      "#include <atomic>\n"
-		  "std::atomic_size_t x = 0;\n"
-		  "size_t foo (size_t v) { \n"
-		  "   return std::atomic_fetch_sub_explicit (&x, v, std::memory_order_acq_rel);\n"
-		  "}\n",
-		  NULL, "CXX_ATOMIC_FETCH_SUB_EXPLICIT");
+/* If the programs built by the compiler cannot be run here or the topology
+   of the target was given then we are cross compiling. Do not run the
+   programs as if --no-run had been given. */
+static void aci_check_cross_compiling (void)
+{
+	const char *reason = NULL;
 
+	if (aci_no_run) {
+		return;
+	}
+	if (aci_target_cpu_topology != NULL) {
+		reason = "--target-cpu-topology was given";
+	} else if (aci_can_compile_link ("int main (void) { return 0; }\n", NULL, NULL, 0)
+	        && aci_run_silent (aci_have_windows ? "a.exe" : "./a.out") != 0) {
+		reason = "the programs built cannot be run here";
+	}
+	printf ("Cross compiling: %s", aci_noyes[reason != NULL]);
+	if (reason != NULL) {
+		printf (" (%s), the programs will not be run as with --no-run", reason);
+		aci_no_run = 1;
+	}
+	printf ("\n");
+	fflush (stdout);
 }
 
 
-/* Check for a bunch of features in one go. */
-static void aci_check_misc_once (void)
-{
-	int has_func_name, has_att;
-	sbuf_t sb;
+/* Concurrency primitives. Each source must compile and link with the
+   libraries given. */
+static const struct {
+	const char *tag;
+	const char *comment;
+	const char *libs;
+	const char *src;
+} aci_concurrency_checks[] = {
+	{ "FUTEX", "Has the futex system call", NULL,
+	  ACI_GNU_SOURCE
+	  "#include <linux/futex.h>\n#include <sys/syscall.h>\n#include <unistd.h>\n"
+	  "int x;\n"
+	  "int main (void) { return (int) syscall (SYS_futex, &x, FUTEX_WAKE_PRIVATE, 1, 0, 0, 0); }\n" },
+	{ "FUTEX_WAITV", "Has the futex_waitv system call", NULL,
+	  ACI_GNU_SOURCE
+	  "#include <linux/futex.h>\n#include <sys/syscall.h>\n#include <unistd.h>\n"
+	  "int main (void) { struct futex_waitv w[1];\n"
+	  "    return (int) syscall (SYS_futex_waitv, w, 0, 0, 0, 0); }\n" },
+	{ "PTHREAD_MUTEX_ADAPTIVE_NP", "Has PTHREAD_MUTEX_ADAPTIVE_NP", "pthread",
+	  ACI_GNU_SOURCE
+	  "#include <pthread.h>\n"
+	  "int main (void) { pthread_mutexattr_t a; pthread_mutexattr_init (&a);\n"
+	  "    return pthread_mutexattr_settype (&a, PTHREAD_MUTEX_ADAPTIVE_NP); }\n" },
+	{ "PTHREAD_SPIN_LOCK", "Has pthread_spin_lock()", "pthread",
+	  "#include <pthread.h>\n"
+	  "pthread_spinlock_t s;\n"
+	  "int main (void) { pthread_spin_init (&s, PTHREAD_PROCESS_PRIVATE); return pthread_spin_lock (&s); }\n" },
+	{ "PTHREAD_SETAFFINITY_NP", "Has pthread_setaffinity_np()", "pthread",
+	  ACI_GNU_SOURCE
+	  "#include <pthread.h>\n#include <sched.h>\n"
+	  "int main (void) { cpu_set_t s; CPU_ZERO (&s); CPU_SET (0, &s);\n"
+	  "    return pthread_setaffinity_np (pthread_self (), sizeof s, &s); }\n" },
+	{ "SCHED_GETCPU", "Has sched_getcpu()", NULL,
+	  ACI_GNU_SOURCE
+	  "#include <sched.h>\n"
+	  "int main (void) { return sched_getcpu (); }\n" },
+	{ "RSEQ", "Has the rseq system call", NULL,
+	  ACI_GNU_SOURCE
+	  "#include <sys/syscall.h>\n#include <unistd.h>\n"
+	  "int main (void) { return (int) syscall (SYS_rseq, 0, 0, 0, 0); }\n" },
+	{ "RSEQ_GLIBC", "Does the C library register rseq", NULL,
+	  ACI_GNU_SOURCE
+	  "#include <sys/rseq.h>\n"
+	  "int main (void) { return (int) __rseq_size + (int) __rseq_offset; }\n" },
+	{ "PTHREAD_RWLOCKATTR_SETKIND_NP", "Has pthread_rwlockattr_setkind_np()", "pthread",
+	  ACI_GNU_SOURCE
+	  "#include <pthread.h>\n"
+	  "int main (void) { pthread_rwlockattr_t a; pthread_rwlockattr_init (&a);\n"
+	  "    return pthread_rwlockattr_setkind_np (&a, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP); }\n" },
+	{ "SCHED_YIELD", "Has sched_yield()", NULL,
+	  "#include <sched.h>\n"
+	  "int main (void) { return sched_yield (); }\n" }
+};
 
-	sbufinit (&sb);
+/* Two threads on the same CPU hand a token back and forth, waiting for it
+   2000 times, waiting for it with sched_yield(). Print the number of calls,
+   which is at most about one per handoff if sched_yield() gives the
+   processor to the other thread. */
+static const char aci_sched_yield_test[] =
+	ACI_GNU_SOURCE
+	"#include <pthread.h>\n#include <sched.h>\n#include <stdio.h>\n"
+	"static volatile int turn, give_up;\n"
+	"static volatile long calls;\n"
+	"static void play (int me)\n{\n"
+	"\tint i;\n"
+	"\tfor (i = 0; i < 1000 && !give_up; ++i) {\n"
+	"\t\twhile (turn != me && !give_up) {\n"
+	"\t\t\tsched_yield ();\n"
+	"\t\t\tif (++calls > 100000) give_up = 1;\n"
+	"\t\t}\n"
+	"\t\tturn = !me;\n"
+	"\t}\n}\n"
+	"static void *other (void *p) { (void) p; play (1); return NULL; }\n"
+	"int main (void)\n{\n"
+	"\tcpu_set_t s;\n"
+	"\tpthread_t t;\n"
+	"\tint i;\n"
+	"\tif (sched_getaffinity (0, sizeof s, &s) == 0) {\n"
+	"\t\tfor (i = 0; i < CPU_SETSIZE && !CPU_ISSET (i, &s); ++i) {}\n"
+	"\t\tCPU_ZERO (&s);\n"
+	"\t\tCPU_SET (i, &s);\n"
+	"\t\tsched_setaffinity (0, sizeof s, &s);\n"
+	"\t}\n"
+	"\tif (pthread_create (&t, NULL, other, NULL) != 0) return 1;\n"
+	"\tplay (0);\n"
+	"\tpthread_join (t, NULL);\n"
+	"\tprintf (\"%ld\\n\", calls);\n"
+	"\treturn 0;\n}\n";
+
+
+/* See if sched_yield() gives the processor to another thread of the same
+   CPU. Unless it has been measured the wait header does not use it. */
+static int aci_check_sched_yield_yields (void)
+{
+	char buf[100];
+	int yields = 0;
+	long calls;
+
+	printf ("Does sched_yield() give the processor to another thread: ");
+	if (aci_no_run) {
+		printf ("not measured\n");
+	} else if (aci_build_and_run (aci_sched_yield_test, NULL, "pthread", buf, sizeof buf)) {
+		calls = strtol (buf, NULL, 10);
+		yields = calls <= 4 * 2000;
+		printf ("%s (%ld calls for 2000 handoffs)\n", aci_noyes[yields], calls);
+	} else {
+		printf ("could not be run\n");
+	}
+	fflush (stdout);
+	ac_add_flag ("SCHED_YIELD_YIELDS", "sched_yield() gives the processor to another thread", yields);
+	return yields;
+}
 
-	/* Enable GNU __attribute__ syntax. */
-	has_att = ac_does_compile ("Has native support for __attribute__(()) syntax",
-	    "__attribute__((unused)) void foo(void);\n", NULL, "GCC_ATTRIBUTE");
 
-	aci_check_thread_local ();
-	aci_check_align_keyword ();
-	aci_check_stdbool ();
-	aci_check_restrict_keyword ();
-	aci_check_va_copy ();
-	aci_check_variadic_macros ();
-	aci_check_flexible_array_member ();
-	aci_check_some_inttypes ();
-	if (!aci_need_cxx_check) {
-		aci_check_mixed_code_vars ();
-	}
-	aci_check_ssize ();
-	aci_check_char32 ();
-/* Not mature enough, yet. */
-/* aci_check_c11_atomics (); */
-	aci_check_builtin_overflow();
+/* Result of each check of aci_concurrency_checks. */
+enum {
+	aci_conc_futex, aci_conc_futex_waitv, aci_conc_adaptive, aci_conc_spin,
+	aci_conc_affinity, aci_conc_getcpu, aci_conc_rseq, aci_conc_rseq_glibc,
+	aci_conc_rwlock_kind, aci_conc_yield, aci_conc_count
+};
 
-	aci_flag_list_add (&aci_flags_root, "WINDOWS", "Are we running MS-Windows", aci_have_windows);
 
-	if (aci_have_windows) {
-		if (aci_have_function_proto ("sys/cygwin.h", NULL, "cygwin_conv_to_win32_path")) {
-			aci_flag_list_add (&aci_flags_root, "CYGWIN", "Are we running under Cygwin", 1);
-			aci_have_cygwin = 1;
-		}
+/* Write the header with the wait primitive. pelconf_wait() blocks while
+   *addr is equal to expected, but may also return spuriously, so it must be
+   called in a loop. pelconf_wake_one() and pelconf_wake_all() wake the
+   threads waiting on addr. Without futex the waiter yields if yields is
+   nonzero and spins otherwise. */
+static void aci_write_wait_header (const char *header, const int *have, int yields)
+{
+	FILE *f;
+	sbuf_t tmpname;
+
+	sbufinit (&tmpname);
+	sbufformat (&tmpname, 1, "%s.tmp", header);
+	f = fopen (sbufchars (&tmpname), "w");
+	if (f == NULL) {
+		fprintf (stderr, "ERROR: could not create the header %s\n", header);
+		exit (EXIT_FAILURE);
 	}
 
-	if (aci_check_define (NULL, NULL, "__MINGW32__")) {
-		 printf ("detected mingw\n");
-		 fflush (stdout);
-		 ac_has_compiler_flag ("-posix", "GCC_POSIX");
+	fprintf (f, "/* Automatically generated by the pelconf program, do not edit. */\n"
+	            "/* Include it before any other system header. */\n"
+	            "#ifndef PELCONF_WAIT_H\n#define PELCONF_WAIT_H\n\n"
+	            "#ifndef _GNU_SOURCE\n#define _GNU_SOURCE 1\n#endif\n\n");
+	if (have[aci_conc_futex]) {
+		fprintf (f, "#include <linux/futex.h>\n#include <sys/syscall.h>\n#include <unistd.h>\n");
+	} else if (yields) {
+		fprintf (f, "#include <sched.h>\n");
+	}
+	fprintf (f, "\n#if defined(__cplusplus) || (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L)\n"
+	            "#define PELCONF_WAIT_INLINE static inline\n"
+	            "#else\n"
+	            "#define PELCONF_WAIT_INLINE static __inline__\n"
+	            "#endif\n\n");
+
+	fprintf (f, "/* Tell the CPU that we are spinning. */\n"
+	            "PELCONF_WAIT_INLINE void pelconf_cpu_relax (void)\n{\n"
+	            "#if defined(__x86_64__) || defined(__i386__)\n"
+	            "\t__builtin_ia32_pause ();\n"
+	            "#elif defined(__aarch64__)\n"
+	            "\t__asm__ __volatile__ (\"yield\");\n"
+	            "#endif\n"
+	            "}\n\n");
+
+	if (have[aci_conc_futex]) {
+		fprintf (f, "#define PELCONF_WAIT_PRIMITIVE \"futex\"\n\n"
+		            "PELCONF_WAIT_INLINE void pelconf_wait (int *addr, int expected)\n{\n"
+		            "\tsyscall (SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);\n"
+		            "}\n\n"
+		            "PELCONF_WAIT_INLINE void pelconf_wake_one (int *addr)\n{\n"
+		            "\tsyscall (SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);\n"
+		            "}\n\n"
+		            "PELCONF_WAIT_INLINE void pelconf_wake_all (int *addr)\n{\n"
+		            "\tsyscall (SYS_futex, addr, FUTEX_WAKE_PRIVATE, 0x7fffffff, NULL, NULL, 0);\n"
+		            "}\n\n");
+	} else {
+		/* Without futex the waiter polls, so there is nothing to wake. */
+		fprintf (f, "#define PELCONF_WAIT_PRIMITIVE \"%s\"\n\n"
+		            "PELCONF_WAIT_INLINE void pelconf_wait (int *addr, int expected)\n{\n"
+		            "\tif (*(volatile int *) addr == expected) {\n",
+		            yields ? "sched_yield" : "spin");
+		fprintf (f, yields ? "\t\tsched_yield ();\n" : "\t\tpelconf_cpu_relax ();\n");
+		fprintf (f, "\t}\n}\n\n"
+		            "PELCONF_WAIT_INLINE void pelconf_wake_one (int *addr)\n{\n"
+		            "\t(void) addr;\n}\n\n"
+		            "PELCONF_WAIT_INLINE void pelconf_wake_all (int *addr)\n{\n"
+		            "\t(void) addr;\n}\n\n");
 	}
+	fprintf (f, "#endif\n");
+	fclose (f);
+
+	if (aci_replace_if_changed (sbufchars (&tmpname), header)) {
+		printf ("Writing the wait header '%s'\n", header);
+	} else {
+		printf ("'%s' is unchanged\n", header);
+	}
+	sbuffree (&tmpname);
+}
+
+
+/* Check for the primitives used to build locks: futex, adaptive mutexes,
+   spin locks, CPU affinity and rseq, and measure whether sched_yield()
+   yields. If header is not NULL then also write it with the best wait
+   primitive. Return the number of primitives found. */
+int ac_check_concurrency (const char *header)
+{
+	int have[aci_conc_count];
+	int i, count = 0, yields = 0;
+
+	for (i = 0; i < aci_conc_count; ++i) {
+		have[i] = ac_does_compile_and_link (aci_concurrency_checks[i].comment,
+		        aci_concurrency_checks[i].src, NULL, aci_concurrency_checks[i].libs,
+		        aci_concurrency_checks[i].tag);
+		count += have[i];
+	}
+
+	if (have[aci_conc_yield]) {
+		yields = aci_check_sched_yield_yields ();
+	}
+	if (header != NULL) {
+		aci_write_wait_header (header, have, yields);
+	}
+	return count;
+}
+
+
+/* Memory interfaces of Linux. Each source must compile and link. */
+static const struct {
+	const char *tag;
+	const char *comment;
+	const char *src;
+} aci_memory_checks[] = {
+	{ "MAP_HUGETLB", "Has mmap() with MAP_HUGETLB",
+	  ACI_GNU_SOURCE
+	  "#include <sys/mman.h>\n"
+	  "int main (void) { return mmap (0, 1 << 21, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0) == MAP_FAILED; }\n" },
+	{ "MAP_POPULATE", "Has mmap() with MAP_POPULATE",
+	  ACI_GNU_SOURCE
+	  "#include <sys/mman.h>\n"
+	  "int main (void) { return mmap (0, 4096, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0) == MAP_FAILED; }\n" },
+	{ "MADV_HUGEPAGE", "Has madvise() with MADV_HUGEPAGE",
+	  ACI_GNU_SOURCE
+	  "#include <sys/mman.h>\n"
+	  "int main (void) { return madvise (0, 0, MADV_HUGEPAGE); }\n" },
+	{ "MADV_DONTNEED", "Has madvise() with MADV_DONTNEED",
+	  ACI_GNU_SOURCE
+	  "#include <sys/mman.h>\n"
+	  "int main (void) { return madvise (0, 0, MADV_DONTNEED); }\n" },
+	{ "MADV_FREE", "Has madvise() with MADV_FREE",
+	  ACI_GNU_SOURCE
+	  "#include <sys/mman.h>\n"
+	  "int main (void) { return madvise (0, 0, MADV_FREE); }\n" },
+	{ "MEMFD_CREATE", "Has memfd_create()",
+	  ACI_GNU_SOURCE
+	  "#include <sys/mman.h>\n"
+	  "int main (void) { return memfd_create (\"pelconf\", MFD_CLOEXEC); }\n" },
+	{ "MLOCK2", "Has mlock2()",
+	  ACI_GNU_SOURCE
+	  "#include <sys/mman.h>\n"
+	  "int main (void) { return mlock2 (0, 0, MLOCK_ONFAULT); }\n" },
+	{ "MEMBARRIER", "Has the membarrier system call",
+	  ACI_GNU_SOURCE
+	  "#include <linux/membarrier.h>\n#include <sys/syscall.h>\n#include <unistd.h>\n"
+	  "int main (void) { return (int) syscall (__NR_membarrier, MEMBARRIER_CMD_QUERY, 0); }\n" }
+};
 
 
+/* Alignment that aligned_alloc() is assumed to accept if the programs cannot
+   be run. C11 requires only the alignments of the fundamental types, but the
+   C libraries of Linux, BSD and macOS accept at least a page. */
+#define ACI_ALIGNED_ALLOC_DEFAULT 4096
+
+/* Print the largest power of two up to 2M that aligned_alloc() accepts. */
+static const char aci_aligned_alloc_test[] =
+	"#include <stdio.h>\n#include <stdlib.h>\n"
+	"int main (void)\n{\n"
+	"\tunsigned long align, best = 0;\n"
+	"\tvoid *p;\n"
+	"\tfor (align = 1; align <= 2UL * 1024 * 1024; align *= 2) {\n"
+	"\t\tp = aligned_alloc (align, align);\n"
+	"\t\tif (p == NULL || (unsigned long) p % align != 0) break;\n"
+	"\t\tfree (p);\n"
+	"\t\tbest = align;\n"
+	"\t}\n"
+	"\tprintf (\"%lu\\n\", best);\n"
+	"\treturn best == 0;\n}\n";
+
+
+/* Check for the interfaces used to place and lock memory: huge pages,
+   madvise(), memfd_create(), mlock2(), membarrier and libnuma. Check for
+   aligned_alloc() and get the largest alignment that it accepts, running a
+   program unless --no-run was given. Also get the alignment of max_align_t,
+   which is what malloc() guarantees. Return the number of interfaces
+   found. */
+int ac_check_memory (void)
+{
+	size_t i;
+	int count = 0;
+	int align;
+	char buf[100];
+	sbuf_t sb;
 
-	if (aci_have_windows) {
-		ac_set_var ("EXE", ".exe");
-		if (!has_att) {
-			aci_attsyn[0] = "__declspec(%s)";
-			has_att = 1;
-		}
-	} else {
-		ac_set_var ("EXE", "");
+	for (i = 0; i < sizeof aci_memory_checks / sizeof aci_memory_checks[0]; ++i) {
+		count += ac_does_compile_and_link (aci_memory_checks[i].comment, aci_memory_checks[i].src,
+		                                   NULL, NULL, aci_memory_checks[i].tag);
 	}
 
+	if (ac_has_func_pkg_config_tag ("numa.h", NULL, "numa_alloc_onnode", "numa", "NUMA_ALLOC_ONNODE")) {
+		++count;
+		count += ac_has_func_lib_tag ("numaif.h", NULL, "mbind", "numa", 0, "MBIND");
+	}
 
-	if (!has_att) {
-		if (aci_have_windows) {
-			ac_add_code ("#define __attribute__(x) __declspec x\n", 1);
+	sbufinit (&sb);
+	if (ac_does_compile_and_link ("Has aligned_alloc()",
+	        "#include <stdlib.h>\n"
+	        "int main (void) { void *p = aligned_alloc (64, 64); free (p); return p == 0; }\n",
+	        NULL, NULL, "ALIGNED_ALLOC")) {
+		++count;
+		align = ACI_ALIGNED_ALLOC_DEFAULT;
+		if (aci_no_run) {
+			printf ("Largest alignment of aligned_alloc(): %d (default)\n", align);
+		} else if (aci_build_and_run (aci_aligned_alloc_test, NULL, NULL, buf, sizeof buf)) {
+			align = atoi (buf);
+			printf ("Largest alignment of aligned_alloc(): %d\n", align);
+		} else {
+			printf ("Largest alignment of aligned_alloc(): %d (could not be run)\n", align);
+		}
+		sbufformat (&sb, 1, "#define %sALIGNED_ALLOC_MAX_ALIGNMENT %d", aci_macro_prefix, align);
+		ac_add_code (sbufchars (&sb), 1);
+	}
+
+	/* _Alignof in C11 and C++11, __alignof__ in older GNU compilers. */
+	for (align = 1; align <= 256; align *= 2) {
+		sbufformat (&sb, 1, "#include <stddef.h>\n"
+		            "#if defined(__cplusplus) && __cplusplus >= 201103L\n#define ACI_ALIGNOF alignof\n"
+		            "#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L\n#define ACI_ALIGNOF _Alignof\n"
+		            "#else\n#define ACI_ALIGNOF __alignof__\n#endif\n"
+		            "char dummy[ACI_ALIGNOF(max_align_t) == %d ? 1 : -1];\n", align);
+		if (aci_can_compile (sbufchars (&sb), NULL)) {
+			break;
+		}
+	}
+	if (align <= 256) {
+		sbufformat (&sb, 1, "#define %sMAX_ALIGN_T_ALIGNMENT %d", aci_macro_prefix, align);
+		ac_add_code (sbufchars (&sb), 1);
+		printf ("Alignment of max_align_t: %d\n", align);
+	} else {
+		printf ("Alignment of max_align_t: unknown\n");
+	}
+	fflush (stdout);
+	sbuffree (&sb);
+
+	return count;
+}
+
+
+/* Convert sizes like "32K" or "8M" to bytes. */
+static long aci_parse_size (const char *s)
+{
+	char *end;
+	long val = strtol (s, &end, 10);
+	if (*end == 'K' || *end == 'k') {
+		val *= 1024;
+	} else if (*end == 'M' || *end == 'm') {
+		val *= 1024 * 1024;
+	}
+	return val;
+}
+
+
+/* Count the CPUs in a list like "0-3,8-11". */
+static long aci_count_cpu_list (const char *s)
+{
+	long count = 0, first, last;
+	char *end;
+
+	while (isdigit ((unsigned char)*s)) {
+		first = last = strtol (s, &end, 10);
+		if (*end == '-') {
+			last = strtol (end + 1, &end, 10);
+		}
+		count += last - first + 1;
+		s = *end == ',' ? end + 1 : end;
+	}
+	return count;
+}
+
+
+/* The values of the CPU topology, their names in --target-cpu-topology and
+   their macros. */
+enum {
+	aci_topo_line, aci_topo_l1d, aci_topo_l2, aci_topo_l3, aci_topo_cores,
+	aci_topo_threads, aci_topo_count
+};
+
+static const struct {
+	const char *key, *macro, *constant, *comment;
+} aci_topology[] = {
+	{ "line", "CPU_CACHE_LINE_SIZE", "cache_line_size", "Cache line size" },
+	{ "l1d", "CPU_L1D_CACHE_SIZE", "l1d_cache_size", "L1 data cache size" },
+	{ "l2", "CPU_L2_CACHE_SIZE", "l2_cache_size", "L2 cache size" },
+	{ "l3", "CPU_L3_CACHE_SIZE", "l3_cache_size", "L3 cache size" },
+	{ "cores", "CPU_CORES", "cores", "Number of cores" },
+	{ "threads", "CPU_THREADS", "threads", "Number of hardware threads" }
+};
+
+
+/* Print the values of aci_topology that sysconf() knows, 0 for the others. */
+static const char aci_sysconf_topology_test[] =
+	ACI_GNU_SOURCE
+	"#include <stdio.h>\n#include <unistd.h>\n"
+	"static long get (int name) { long v = sysconf (name); return v > 0 ? v : 0; }\n"
+	"int main (void)\n{\n"
+	"\tlong v[6] = { 0, 0, 0, 0, 0, 0 };\n"
+	"#ifdef _SC_LEVEL1_DCACHE_LINESIZE\n\tv[0] = get (_SC_LEVEL1_DCACHE_LINESIZE);\n#endif\n"
+	"#ifdef _SC_LEVEL1_DCACHE_SIZE\n\tv[1] = get (_SC_LEVEL1_DCACHE_SIZE);\n#endif\n"
+	"#ifdef _SC_LEVEL2_CACHE_SIZE\n\tv[2] = get (_SC_LEVEL2_CACHE_SIZE);\n#endif\n"
+	"#ifdef _SC_LEVEL3_CACHE_SIZE\n\tv[3] = get (_SC_LEVEL3_CACHE_SIZE);\n#endif\n"
+	"#ifdef _SC_NPROCESSORS_ONLN\n\tv[5] = get (_SC_NPROCESSORS_ONLN);\n#endif\n"
+	"\tprintf (\"%ld %ld %ld %ld %ld %ld\\n\", v[0], v[1], v[2], v[3], v[4], v[5]);\n"
+	"\treturn 0;\n}\n";
+
+
+/* Read the topology of the host. Ask sysconf() in a program built and run
+   here, unless --no-run was given, and read the values that it does not
+   know from /sys/devices/system/cpu. Set src to where each value came
+   from. */
+static void aci_read_host_topology (long *val, const char **src)
+{
+	char name[FILENAME_MAX], buf[100], type[100];
+	char *cp, *end;
+	int i;
+	long level, siblings, v;
+
+	if (!aci_no_run && aci_build_and_run (aci_sysconf_topology_test, NULL, NULL, buf, sizeof buf)) {
+		cp = buf;
+		for (i = 0; i < aci_topo_count; ++i) {
+			v = strtol (cp, &end, 10);
+			if (end == cp) {
+				break;
+			}
+			if (v > 0) {
+				val[i] = v;
+				src[i] = "sysconf";
+			}
+			cp = end;
+		}
+	}
+
+	for (i = 0; i < 10; ++i) {
+		sprintf (name, "/sys/devices/system/cpu/cpu0/cache/index%d/level", i);
+		if (!aci_read_line_file (name, buf, sizeof buf)) {
+			break;
+		}
+		level = strtol (buf, NULL, 10);
+		sprintf (name, "/sys/devices/system/cpu/cpu0/cache/index%d/type", i);
+		if (!aci_read_line_file (name, type, sizeof type) || strcmp (type, "Instruction") == 0) {
+			continue;
+		}
+		sprintf (name, "/sys/devices/system/cpu/cpu0/cache/index%d/size", i);
+		if (level >= 1 && level <= 3 && val[aci_topo_l1d + level - 1] <= 0
+		        && aci_read_line_file (name, buf, sizeof buf)) {
+			val[aci_topo_l1d + level - 1] = aci_parse_size (buf);
+			src[aci_topo_l1d + level - 1] = "sysfs";
+		}
+		sprintf (name, "/sys/devices/system/cpu/cpu0/cache/index%d/coherency_line_size", i);
+		if (level == 1 && val[aci_topo_line] <= 0 && aci_read_line_file (name, buf, sizeof buf)) {
+			val[aci_topo_line] = strtol (buf, NULL, 10);
+			src[aci_topo_line] = "sysfs";
+		}
+	}
+
+	if (val[aci_topo_threads] <= 0 && aci_read_line_file ("/sys/devices/system/cpu/online", buf, sizeof buf)) {
+		val[aci_topo_threads] = aci_count_cpu_list (buf);
+		src[aci_topo_threads] = "sysfs";
+	}
+	if (val[aci_topo_threads] > 0
+	        && aci_read_line_file ("/sys/devices/system/cpu/cpu0/topology/thread_siblings_list", buf, sizeof buf)) {
+		siblings = aci_count_cpu_list (buf);
+		if (siblings > 0) {
+			val[aci_topo_cores] = val[aci_topo_threads] / siblings;
+			src[aci_topo_cores] = "sysfs";
+		}
+	}
+}
+
+
+/* Get the cache sizes, the cache line size and the number of cores and
+   threads. They come from sysconf() and /sys/devices/system/cpu of the host,
+   unless they are given with --target-cpu-topology=line=64,l1d=32K,... for
+   cross compilation. The values are written as macros and, for C++11, as
+   constexpr constants in the namespace pelconf. Return the cache line
+   size. */
+int ac_check_cpu_topology (void)
+{
+	long val[aci_topo_count];
+	const char *src[aci_topo_count];
+	const char *cp, *eq;
+	int i, hdi;
+	size_t len;
+	sbuf_t sb, cxx;
+
+	for (i = 0; i < aci_topo_count; ++i) {
+		val[i] = 0;
+		src[i] = "host";
+	}
+
+	if (aci_target_cpu_topology != NULL) {
+		for (i = 0; i < aci_topo_count; ++i) {
+			src[i] = "given";
+		}
+		cp = aci_target_cpu_topology;
+		while (*cp) {
+			eq = strchr (cp, '=');
+			if (eq == NULL) {
+				ac_msg_error ("invalid --target-cpu-topology");
+			}
+			len = eq - cp;
+			for (i = 0; i < aci_topo_count; ++i) {
+				if (strlen (aci_topology[i].key) == len
+				        && strncmp (cp, aci_topology[i].key, len) == 0) {
+					val[i] = aci_parse_size (eq + 1);
+					break;
+				}
+			}
+			if (i == aci_topo_count) {
+				ac_msg_error ("unknown value in --target-cpu-topology");
+			}
+			cp = strchr (eq, ',');
+			cp = cp ? cp + 1 : eq + strlen (eq);
+		}
+	} else {
+		aci_read_host_topology (val, src);
+	}
+
+	if (val[aci_topo_line] <= 0) {
+		val[aci_topo_line] = 64;
+		src[aci_topo_line] = "default";
+	}
+
+	sbufinit (&sb);
+	sbufinit (&cxx);
+	sbufcpy (&cxx, "#if defined(__cplusplus) && __cplusplus >= 201103L\nnamespace pelconf {\n");
+	for (i = 0; i < aci_topo_count; ++i) {
+		if (val[i] <= 0) {
+			printf ("%s: unknown\n", aci_topology[i].comment);
+			continue;
+		}
+		printf ("%s: %ld (%s)\n", aci_topology[i].comment, val[i], src[i]);
+		sbufformat (&sb, 1, "#define %s%s %d", aci_macro_prefix, aci_topology[i].macro, (int) val[i]);
+		ac_add_code (sbufchars (&sb), 1);
+		sbufformat (&cxx, 0, "\tconstexpr long %s = %s%s;\n", aci_topology[i].constant,
+		            aci_macro_prefix, aci_topology[i].macro);
+	}
+
+	/* The compiler knows the value for the target. */
+	hdi = 0;
+	for (i = 32; i <= 256 && hdi == 0; i *= 2) {
+		sbufformat (&sb, 1, "#include <new>\n"
+		            "char dummy[std::hardware_destructive_interference_size == %d ? 1 : -1];\n", i);
+		if (aci_can_compile (sbufchars (&sb), NULL)) {
+			hdi = i;
+		}
+	}
+	if (hdi != 0) {
+		printf ("Destructive interference size: %d (compiler)\n", hdi);
+	} else {
+		hdi = (int) val[aci_topo_line];
+		printf ("Destructive interference size: %d (%s)\n", hdi, src[aci_topo_line]);
+	}
+	sbufformat (&sb, 1, "#define %sCPU_DESTRUCTIVE_INTERFERENCE_SIZE %d", aci_macro_prefix, hdi);
+	ac_add_code (sbufchars (&sb), 1);
+	sbufformat (&cxx, 0, "\tconstexpr long destructive_interference_size = %sCPU_DESTRUCTIVE_INTERFERENCE_SIZE;\n"
+	            "}\n#endif", aci_macro_prefix);
+	ac_add_code (sbufchars (&cxx), 1);
+	fflush (stdout);
+
+	sbuffree (&sb);
+	sbuffree (&cxx);
+	return (int) val[aci_topo_line];
+}
+
+
+/* The flags of the optimized build, used to build the benchmarks. */
+static const char aci_bench_flags[] = "$(CFLAGS) $(CFLAGS_OPTIMIZE) $(LDFLAGS_OPTIMIZE)";
+
+/* Number of times that each candidate of ac_benchmark_select() is run. */
+#define ACI_BENCH_ITERATIONS 1000000L
+
+/* A candidate implementation for ac_benchmark_select(). */
+typedef struct {
+	const char *name;
+	const char *code;
+} ac_bench_candidate_t;
+
+
+/* Append to dst the value "value" with the makefile variables expanded as
+   make would do it. Undefined variables are empty. */
+static void aci_expand_makevars (sbuf_t *dst, const char *value, int depth)
+{
+	const char *cp, *close;
+	aci_varnode_t *vn;
+	char **beg, **end;
+	sbuf_t name;
+
+	sbufinit (&name);
+	for (cp = value; *cp; ++cp) {
+		if (cp[0] == '$' && cp[1] == '$') {
+			sbufcat (dst, "$");
+			++cp;
+		} else if (cp[0] == '$' && (cp[1] == '(' || cp[1] == '{') &&
+		        (close = strchr (cp + 2, cp[1] == '(' ? ')' : '}')) != NULL) {
+			sbufncpy (&name, cp + 2, close - cp - 2);
+			vn = aci_varlist_find (&aci_makevars, sbufchars (&name));
+			if (vn && depth < 20) {
+				beg = aci_strlist_begin (&vn->chunks);
+				end = aci_strlist_end (&vn->chunks);
+				for (; beg != end; ++beg) {
+					sbufcat (dst, " ");
+					aci_expand_makevars (dst, *beg, depth + 1);
+				}
+			}
+			cp = close;
+		} else if (cp[0] == '\\' && (cp[1] == 0 || cp[1] == '\n')) {
+			/* Line continuation. */
+			sbufcat (dst, " ");
+		} else {
+			sbufncat (dst, cp, 1);
+		}
+	}
+	sbuffree (&name);
+}
+
+
+/* Build the candidate with the flags of the optimized build and run it.
+   Return the time of each iteration in nanoseconds or a negative value if
+   it could not be built or run. */
+static double aci_run_benchmark (const char *harness, const ac_bench_candidate_t *cand,
+                                 const char *flags)
+{
+	sbuf_t src;
+	char buf[100];
+	double t = -1.0;
+
+	sbufinit (&src);
+	sbufformat (&src, 1, "%s\n#include <stdio.h>\n#include <time.h>\n"
+	            "#ifndef PELCONF_BENCH_ITERATIONS\n#define PELCONF_BENCH_ITERATIONS %d\n#endif\n"
+	            "volatile unsigned long pelconf_bench_sink;\n"
+	            "static void pelconf_bench_step (void)\n{\n%s\n}\n",
+	            harness ? harness : "", (int) ACI_BENCH_ITERATIONS, cand->code);
+	/* Call through a volatile pointer so that the compiler cannot hoist the
+	   work out of the loop. Keep the best of three runs. */
+	sbufcat (&src, "static void (*volatile pelconf_bench_fn) (void) = pelconf_bench_step;\n"
+	         "int main (void)\n{\n"
+	         "\tdouble best = 0, t;\n\tlong i;\n\tint r;\n\tclock_t t0;\n"
+	         "\tfor (r = 0; r < 3; ++r) {\n"
+	         "\t\tt0 = clock ();\n"
+	         "\t\tfor (i = 0; i < PELCONF_BENCH_ITERATIONS; ++i) pelconf_bench_fn ();\n"
+	         "\t\tt = (double) (clock () - t0) * 1e9 / CLOCKS_PER_SEC / PELCONF_BENCH_ITERATIONS;\n"
+	         "\t\tif (r == 0 || t < best) best = t;\n"
+	         "\t}\n"
+	         "\tprintf (\"%.3f\\n\", best);\n"
+	         "\treturn 0;\n}\n");
+
+	if (aci_build_and_run (sbufchars (&src), flags, NULL, buf, sizeof buf)) {
+		t = strtod (buf, NULL);
+	}
+	sbuffree (&src);
+	return t;
+}
+
+
+/* Build each candidate with the optimized flags, run it and define the macro
+   <tag>_<name> of the fastest one and <tag> as its name. The macro names are
+   made identifiers with aci_identcat(). The candidates end
+   with a NULL name. The first candidate is the default, used when the
+   programs cannot be run. Return the index of the candidate chosen. */
+int ac_benchmark_select (const char *tag, const ac_bench_candidate_t *candidates,
+                         const char *harness)
+{
+	sbuf_t flags, sb;
+	FILE *logfile;
+	double t, best = -1.0;
+	int i, chosen = 0;
+
+	printf ("Selecting the fastest %s:", tag);
+	if (aci_no_run) {
+		printf (" %s (default, --no-run)\n", candidates[0].name);
+	} else {
+		printf ("\n");
+		sbufinit (&flags);
+		aci_expand_makevars (&flags, aci_bench_flags, 0);
+		logfile = fopen ("configure.log", "a");
+		for (i = 0; candidates[i].name != NULL; ++i) {
+			t = aci_run_benchmark (harness, &candidates[i], sbufchars (&flags));
+			if (t < 0) {
+				printf ("  %s: could not be run\n", candidates[i].name);
+			} else {
+				/* sbufformat() cannot print doubles. */
+				printf ("  %s: %.3f ns\n", candidates[i].name, t);
+				if (best < 0 || t < best) {
+					best = t;
+					chosen = i;
+				}
+			}
+			if (logfile && t < 0) {
+				fprintf (logfile, "benchmark %s %s: could not be run\n", tag, candidates[i].name);
+			} else if (logfile) {
+				fprintf (logfile, "benchmark %s %s: %.3f ns\n", tag, candidates[i].name, t);
+			}
+		}
+		if (logfile) {
+			fclose (logfile);
+		}
+		if (best < 0) {
+			printf ("  using the default %s\n", candidates[0].name);
+		} else {
+			printf ("  using %s\n", candidates[chosen].name);
+		}
+		sbuffree (&flags);
+	}
+	fflush (stdout);
+
+	/* The names may have characters like '-' that cannot be in a macro. */
+	sbufinit (&sb);
+	sbufformat (&sb, 1, "#define %s", aci_macro_prefix);
+	aci_identcat (&sb, tag);
+	sbufcat (&sb, "_");
+	aci_identcat (&sb, candidates[chosen].name);
+	sbufformat (&sb, 0, " 1\n#define %s", aci_macro_prefix);
+	aci_identcat (&sb, tag);
+	sbufformat (&sb, 0, " \"%s\"", candidates[chosen].name);
+	ac_add_code (sbufchars (&sb), 1);
+	sbuffree (&sb);
+	return chosen;
+}
+
+
+/* The clocks measured by ac_check_timers(). Each source defines the function
+   pelconf_timer_read() and, if it does not return nanoseconds,
+   PELCONF_TIMER_TICKS. PELCONF_TIMER_CHECK() tells if it can be used. */
+static const struct {
+	const char *name;
+	const char *comment;
+	const char *clock_id;
+	int fallback;
+	const char *src;
+} aci_timers[] = {
+	{ "CLOCK_MONOTONIC", "clock_gettime(CLOCK_MONOTONIC)", "CLOCK_MONOTONIC", 1,
+	  ACI_GNU_SOURCE
+	  "#include <time.h>\n"
+	  "static unsigned long long pelconf_timer_read (void)\n"
+	  "{ struct timespec ts; clock_gettime (CLOCK_MONOTONIC, &ts);\n"
+	  "  return ts.tv_sec * 1000000000ULL + ts.tv_nsec; }\n" },
+	{ "CLOCK_MONOTONIC_RAW", "clock_gettime(CLOCK_MONOTONIC_RAW)", "CLOCK_MONOTONIC_RAW", 0,
+	  ACI_GNU_SOURCE
+	  "#include <time.h>\n"
+	  "static unsigned long long pelconf_timer_read (void)\n"
+	  "{ struct timespec ts; clock_gettime (CLOCK_MONOTONIC_RAW, &ts);\n"
+	  "  return ts.tv_sec * 1000000000ULL + ts.tv_nsec; }\n" },
+	{ "CLOCK_MONOTONIC_COARSE", "clock_gettime(CLOCK_MONOTONIC_COARSE)", "CLOCK_MONOTONIC_COARSE", 0,
+	  ACI_GNU_SOURCE
+	  "#include <time.h>\n"
+	  "static unsigned long long pelconf_timer_read (void)\n"
+	  "{ struct timespec ts; clock_gettime (CLOCK_MONOTONIC_COARSE, &ts);\n"
+	  "  return ts.tv_sec * 1000000000ULL + ts.tv_nsec; }\n" },
+	{ "RDTSC", "rdtsc with invariant TSC", NULL, 0,
+	  "#include <x86intrin.h>\n#include <cpuid.h>\n"
+	  "#define PELCONF_TIMER_TICKS 1\n"
+	  "static unsigned long long pelconf_timer_read (void) { return __rdtsc (); }\n"
+	  "static int pelconf_timer_check (void)\n"
+	  "{ unsigned a, b, c, d;\n"
+	  "  return __get_cpuid (0x80000007, &a, &b, &c, &d) && (d & (1u << 8)); }\n"
+	  "#define PELCONF_TIMER_CHECK() pelconf_timer_check ()\n" },
+	{ "GETTIMEOFDAY", "gettimeofday()", NULL, 1,
+	  "#include <sys/time.h>\n"
+	  "static unsigned long long pelconf_timer_read (void)\n"
+	  "{ struct timeval tv; gettimeofday (&tv, 0);\n"
+	  "  return tv.tv_sec * 1000000000ULL + tv.tv_usec * 1000ULL; }\n" }
+};
+
+
+/* Measure the average cost of a call and the smallest step seen between
+   two readings. The ticks of the TSC are converted to nanoseconds with
+   clock(), which is accurate enough while the program is busy. */
+static const char aci_timer_main[] =
+	"#include <stdio.h>\n#include <time.h>\n"
+	"#ifndef PELCONF_TIMER_CHECK\n#define PELCONF_TIMER_CHECK() 1\n#endif\n"
+	"volatile unsigned long long pelconf_sink;\n"
+	"static double pelconf_elapsed (clock_t t0)\n"
+	"{ return (double) (clock () - t0) * 1e9 / CLOCKS_PER_SEC; }\n"
+	"int main (void)\n{\n"
+	"\tunsigned long long a, b, res = 0;\n"
+	"\tdouble ns_per_tick = 1.0, cost;\n"
+	"\tclock_t t0;\n\tlong i, n = 1000000L, steps = 0;\n"
+	"\tif (!PELCONF_TIMER_CHECK ()) return 1;\n"
+	"#ifdef PELCONF_TIMER_TICKS\n"
+	"\tt0 = clock ();\n\ta = pelconf_timer_read ();\n"
+	"\twhile (clock () - t0 < CLOCKS_PER_SEC / 20) {}\n"
+	"\tb = pelconf_timer_read ();\n"
+	"\tns_per_tick = pelconf_elapsed (t0) / (double) (b - a);\n"
+	"#endif\n"
+	"\tt0 = clock ();\n"
+	"\tfor (i = 0; i < n; ++i) pelconf_sink += pelconf_timer_read ();\n"
+	"\tcost = pelconf_elapsed (t0) / n;\n"
+	"\ta = pelconf_timer_read ();\n"
+	"\tfor (i = 0; i < 100 * n && steps < 10; ++i) {\n"
+	"\t\tb = pelconf_timer_read ();\n"
+	"\t\tif (b > a) {\n"
+	"\t\t\tif (res == 0 || b - a < res) res = b - a;\n"
+	"\t\t\t++steps;\n"
+	"\t\t}\n"
+	"\t\ta = b;\n"
+	"\t}\n"
+	"\tprintf (\"%.3f %.3f\\n\", cost, (double) res * ns_per_tick);\n"
+	"\treturn 0;\n}\n";
+
+
+/* Build and run a harness for each clock to measure the cost of reading it
+   and its resolution. Define HAVE_TIMER_<name> for the clocks available,
+   TIMER_<name>_COST_NS and TIMER_<name>_RESOLUTION_NS with the measurements
+   and BEST_FAST_CLOCK with the cheapest clock whose resolution is 1 us or
+   better. Return the number of clocks available. */
+int ac_check_timers (void)
+{
+	int n = (int) (sizeof aci_timers / sizeof aci_timers[0]);
+	double cost, res, best_cost = -1.0;
+	int i, ok, count = 0, best = -1, fallback = -1, coarse = -1;
+	char buf[100];
+	sbuf_t flags, src, sb;
+	FILE *logfile;
+
+	sbufinit (&flags);
+	sbufinit (&src);
+	sbufinit (&sb);
+	aci_expand_makevars (&flags, aci_bench_flags, 0);
+	for (i = 0; i < n; ++i) {
+		sbufcpy (&src, aci_timers[i].src);
+		sbufcat (&src, aci_timer_main);
+		printf ("Has the timer %s: ", aci_timers[i].comment);
+		fflush (stdout);
+		if (aci_no_run) {
+			/* The TSC cannot be checked without running. */
+			ok = aci_timers[i].clock_id != NULL || aci_timers[i].fallback;
+			ok = ok && (aci_can_compile_link (sbufchars (&src), sbufchars (&flags), NULL, 0) ||
+			            aci_can_compile_link (sbufchars (&src), sbufchars (&flags), "rt", 0));
+			printf ("%s\n", aci_noyes[ok]);
+		} else {
+			ok = aci_build_and_run (sbufchars (&src), sbufchars (&flags), NULL, buf, sizeof buf) ||
+			     aci_build_and_run (sbufchars (&src), sbufchars (&flags), "rt", buf, sizeof buf);
+			if (ok && sscanf (buf, "%lf %lf", &cost, &res) == 2) {
+				/* sbufformat() cannot print doubles. */
+				printf ("yes, %.1f ns per call, resolution %.1f ns\n", cost, res);
+				sprintf (buf, "%.1f", cost);
+				sbufformat (&sb, 1, "#define %sTIMER_%s_COST_NS %s\n", aci_macro_prefix,
+				            aci_timers[i].name, buf);
+				sprintf (buf, "%.1f", res);
+				sbufformat (&sb, 0, "#define %sTIMER_%s_RESOLUTION_NS %s", aci_macro_prefix,
+				            aci_timers[i].name, buf);
+				ac_add_code (sbufchars (&sb), 1);
+				logfile = fopen ("configure.log", "a");
+				if (logfile) {
+					fprintf (logfile, "timer %s: %.3f ns per call, resolution %.3f ns\n",
+					         aci_timers[i].name, cost, res);
+					fclose (logfile);
+				}
+				if (res > 0 && res <= 1000.0) {
+					if (best < 0 || cost < best_cost) {
+						best = i;
+						best_cost = cost;
+					}
+				} else if (coarse < 0) {
+					coarse = i;
+				}
+			} else {
+				ok = 0;
+				printf ("no\n");
+			}
+		}
+		if (ok && fallback < 0 && aci_timers[i].fallback) {
+			fallback = i;
+		}
+		sbufcpy (&sb, "TIMER_");
+		sbufcat (&sb, aci_timers[i].name);
+		ac_add_flag (sbufchars (&sb), aci_timers[i].comment, ok);
+		count += ok;
+	}
+
+	if (best < 0) {
+		best = fallback >= 0 ? fallback : coarse;
+	}
+	if (best >= 0) {
+		printf ("The best fast clock is %s\n", aci_timers[best].comment);
+		sbufformat (&sb, 1, "#define %sBEST_FAST_CLOCK_%s 1\n#define %sBEST_FAST_CLOCK \"%s\"",
+		            aci_macro_prefix, aci_timers[best].name, aci_macro_prefix, aci_timers[best].name);
+		if (aci_timers[best].clock_id) {
+			sbufformat (&sb, 0, "\n#define %sBEST_FAST_CLOCK_ID %s", aci_macro_prefix,
+			            aci_timers[best].clock_id);
+		}
+		ac_add_code (sbufchars (&sb), 1);
+	} else {
+		printf ("No fast clock was found\n");
+	}
+	fflush (stdout);
+
+	sbuffree (&flags);
+	sbuffree (&src);
+	sbuffree (&sb);
+	return count;
+}
+
+
+/* Representative loops for ac_check_vectorization() and the size of their
+   elements, used to convert the number of elements reported by clang. */
+static const struct {
+	const char *name;
+	const char *comment;
+	int elem_size;
+	const char *src;
+} aci_vector_kernels[] = {
+	{ "REDUCTION", "an integer reduction", 4,
+	  "int pelconf_sum (const int *a, int n)\n"
+	  "{ int i, s = 0; for (i = 0; i < n; ++i) s += a[i]; return s; }\n" },
+	{ "GATHER", "an indexed gather", 4,
+	  "void pelconf_gather (float *__restrict d, const float *__restrict s,\n"
+	  "                     const int *__restrict idx, int n)\n"
+	  "{ int i; for (i = 0; i < n; ++i) d[i] = s[idx[i]]; }\n" },
+	{ "DOT_PRODUCT", "a float dot product", 4,
+	  "float pelconf_dot (const float *__restrict a, const float *__restrict b, int n)\n"
+	  "{ int i; float s = 0; for (i = 0; i < n; ++i) s += a[i] * b[i]; return s; }\n" }
+};
+
+
+/* Return the width in bytes of the vectors used for the loop according to
+   the remarks of the compiler written to "fname", or 0 if the loop was not
+   vectorized. GCC reports "loop vectorized using 32 byte vectors" and clang
+   "vectorized loop (vectorization width: 8, ...". */
+static int aci_vector_width (const char *fname, int elem_size)
+{
+	FILE *f;
+	char line[1000];
+	const char *cp;
+	int width = 0, w;
+
+	f = fopen (fname, "r");
+	if (f == NULL) {
+		return 0;
+	}
+	while (fgets (line, sizeof line, f) != NULL) {
+		w = 0;
+		if ((cp = strstr (line, "loop vectorized")) != NULL) {
+			cp = strstr (cp, "using ");
+			/* Older versions of GCC do not give the size. */
+			w = cp ? atoi (cp + 6) : 1;
+		} else if ((cp = strstr (line, "vectorization width: ")) != NULL) {
+			w = atoi (cp + 21) * elem_size;
+		}
+		if (w > width) {
+			width = w;
+		}
+	}
+	fclose (f);
+	return width;
+}
+
+
+/* Compile representative loops with the optimized flags, including
+   TARGET_ARCH, and ask the compiler which ones were vectorized. Define
+   VECTORIZES_<name> for them and VECTORIZES_<name>_WIDTH with the width of
+   the vectors in bytes. VECTOR_WIDTH is the widest vector used. Return it,
+   or 0 if no loop was vectorized or the compiler gives no feedback. */
+int ac_check_vectorization (void)
+{
+	int n = (int) (sizeof aci_vector_kernels / sizeof aci_vector_kernels[0]);
+	int i, w, widest = 0;
+	const char *remark;
+	sbuf_t flags, sb;
+
+	if (aci_compiler_id == aci_cc_gcc) {
+		remark = " -fopt-info-vec-optimized";
+	} else if (aci_compiler_id == aci_cc_clang) {
+		remark = " -Rpass=loop-vectorize";
+	} else {
+		printf ("Checking vectorization: the compiler gives no feedback\n");
+		fflush (stdout);
+		return 0;
+	}
+
+	sbufinit (&flags);
+	sbufinit (&sb);
+	aci_expand_makevars (&flags, "$(CFLAGS) $(CFLAGS_OPTIMIZE)", 0);
+	sbufcat (&flags, remark);
+	for (i = 0; i < n; ++i) {
+		w = 0;
+		if (aci_can_compile (aci_vector_kernels[i].src, sbufchars (&flags))) {
+			w = aci_vector_width (aci_stderr_dummy, aci_vector_kernels[i].elem_size);
+		}
+		if (w == 0) {
+			printf ("Vectorizes %s: no\n", aci_vector_kernels[i].comment);
+			continue;
+		}
+		printf ("Vectorizes %s: yes, %d byte vectors\n", aci_vector_kernels[i].comment, w);
+		sbufformat (&sb, 1, "#define %sVECTORIZES_%s 1\n#define %sVECTORIZES_%s_WIDTH %d",
+		            aci_macro_prefix, aci_vector_kernels[i].name,
+		            aci_macro_prefix, aci_vector_kernels[i].name, w);
+		ac_add_code (sbufchars (&sb), 1);
+		if (w > widest) {
+			widest = w;
+		}
+	}
+	if (widest > 0) {
+		sbufformat (&sb, 1, "#define %sVECTOR_WIDTH %d", aci_macro_prefix, widest);
+		ac_add_code (sbufchars (&sb), 1);
+	}
+	fflush (stdout);
+
+	sbuffree (&flags);
+	sbuffree (&sb);
+	return widest;
+}
+
+
+/* Open a counter of cycles for the current process, as the header does. */
+static const char aci_perf_open_test[] =
+	ACI_GNU_SOURCE
+	"#include <stdio.h>\n#include <string.h>\n#include <unistd.h>\n"
+	"#include <sys/syscall.h>\n#include <linux/perf_event.h>\n"
+	"int main (void)\n{\n"
+	"\tstruct perf_event_attr attr;\n"
+	"\tmemset (&attr, 0, sizeof attr);\n"
+	"\tattr.type = PERF_TYPE_HARDWARE;\n"
+	"\tattr.size = sizeof attr;\n"
+	"\tattr.config = PERF_COUNT_HW_CPU_CYCLES;\n"
+	"\tattr.exclude_kernel = 1;\n"
+	"\tattr.exclude_hv = 1;\n"
+	"\tif (syscall (SYS_perf_event_open, &attr, 0, -1, -1, 0) < 0) return 1;\n"
+	"\tprintf (\"ok\\n\");\n"
+	"\treturn 0;\n}\n";
+
+
+/* Write the header with the counter group API. pelconf_perf_open() opens
+   the cycles, instructions and cache misses of the calling thread as a
+   group, pelconf_perf_start() and pelconf_perf_stop() delimit the section
+   measured and leave the counts in value[]. If the counters are not
+   available the functions do nothing and pelconf_perf_open() fails. */
+static void aci_write_perf_header (const char *header, int have_perf, int have_rdpmc)
+{
+	FILE *f;
+	sbuf_t tmpname;
+
+	sbufinit (&tmpname);
+	sbufformat (&tmpname, 1, "%s.tmp", header);
+	f = fopen (sbufchars (&tmpname), "w");
+	if (f == NULL) {
+		fprintf (stderr, "ERROR: could not create the header %s\n", header);
+		exit (EXIT_FAILURE);
+	}
+
+	fputs ("/* Automatically generated by the pelconf program, do not edit. */\n"
+	       "/* Include it before any other system header. */\n"
+	       "#ifndef PELCONF_PERF_H\n#define PELCONF_PERF_H\n\n"
+	       "#ifndef _GNU_SOURCE\n#define _GNU_SOURCE 1\n#endif\n\n"
+	       "#include <stdint.h>\n", f);
+	if (have_perf) {
+		fputs ("#include <string.h>\n#include <unistd.h>\n#include <sys/ioctl.h>\n"
+		       "#include <sys/mman.h>\n#include <sys/syscall.h>\n#include <linux/perf_event.h>\n", f);
+	}
+	fputs ("\n#if defined(__cplusplus) || (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L)\n"
+	       "#define PELCONF_PERF_INLINE static inline\n"
+	       "#else\n"
+	       "#define PELCONF_PERF_INLINE static __inline__\n"
+	       "#endif\n\n"
+	       "enum { PELCONF_PERF_CYCLES, PELCONF_PERF_INSTRUCTIONS, PELCONF_PERF_CACHE_MISSES,\n"
+	       "       PELCONF_PERF_COUNT };\n\n"
+	       "typedef struct {\n"
+	       "\tint fd[PELCONF_PERF_COUNT];\n"
+	       "\tuint64_t value[PELCONF_PERF_COUNT];\n"
+	       "\tvoid *page;\n"
+	       "} pelconf_perf_t;\n\n", f);
+
+	if (!have_perf) {
+		fputs ("#define PELCONF_PERF_AVAILABLE 0\n\n"
+		       "PELCONF_PERF_INLINE int pelconf_perf_open (pelconf_perf_t *g)\n{\n"
+		       "\tint i;\n"
+		       "\tfor (i = 0; i < PELCONF_PERF_COUNT; ++i) {\n"
+		       "\t\tg->fd[i] = -1;\n\t\tg->value[i] = 0;\n"
+		       "\t}\n"
+		       "\tg->page = 0;\n"
+		       "\treturn -1;\n}\n\n"
+		       "PELCONF_PERF_INLINE void pelconf_perf_start (pelconf_perf_t *g) { (void) g; }\n"
+		       "PELCONF_PERF_INLINE void pelconf_perf_stop (pelconf_perf_t *g) { (void) g; }\n"
+		       "PELCONF_PERF_INLINE void pelconf_perf_close (pelconf_perf_t *g) { (void) g; }\n"
+		       "PELCONF_PERF_INLINE uint64_t pelconf_perf_read_cycles (pelconf_perf_t *g)\n"
+		       "{\n\t(void) g;\n\treturn 0;\n}\n\n"
+		       "#endif\n", f);
+	} else {
+		fputs ("#define PELCONF_PERF_AVAILABLE 1\n\n"
+		       "/* Open the counters of the calling thread in user mode. Return 0 on\n"
+		       "   success and -1 if they are not available. */\n"
+		       "PELCONF_PERF_INLINE int pelconf_perf_open (pelconf_perf_t *g)\n{\n"
+		       "\tstatic const uint64_t config[PELCONF_PERF_COUNT] = {\n"
+		       "\t\tPERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES\n"
+		       "\t};\n"
+		       "\tstruct perf_event_attr attr;\n"
+		       "\tvoid *p;\n"
+		       "\tint i;\n\n"
+		       "\tmemset (g, 0, sizeof *g);\n"
+		       "\tfor (i = 0; i < PELCONF_PERF_COUNT; ++i) {\n"
+		       "\t\tmemset (&attr, 0, sizeof attr);\n"
+		       "\t\tattr.type = PERF_TYPE_HARDWARE;\n"
+		       "\t\tattr.size = sizeof attr;\n"
+		       "\t\tattr.config = config[i];\n"
+		       "\t\tattr.disabled = i == 0;\n"
+		       "\t\tattr.exclude_kernel = 1;\n"
+		       "\t\tattr.exclude_hv = 1;\n"
+		       "\t\tattr.read_format = PERF_FORMAT_GROUP;\n"
+		       "\t\tg->fd[i] = (int) syscall (SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : g->fd[0], 0);\n"
+		       "\t\tif (g->fd[i] < 0) {\n"
+		       "\t\t\twhile (i-- > 0) close (g->fd[i]);\n"
+		       "\t\t\tg->fd[0] = -1;\n"
+		       "\t\t\treturn -1;\n"
+		       "\t\t}\n"
+		       "\t}\n"
+		       "\tp = mmap (0, (size_t) sysconf (_SC_PAGESIZE), PROT_READ, MAP_SHARED, g->fd[0], 0);\n"
+		       "\tg->page = p == MAP_FAILED ? 0 : p;\n"
+		       "\treturn 0;\n}\n\n"
+		       "PELCONF_PERF_INLINE void pelconf_perf_start (pelconf_perf_t *g)\n{\n"
+		       "\tif (g->fd[0] < 0) return;\n"
+		       "\tioctl (g->fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);\n"
+		       "\tioctl (g->fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);\n"
+		       "}\n\n"
+		       "/* Stop the counters and store their values in g->value. */\n"
+		       "PELCONF_PERF_INLINE void pelconf_perf_stop (pelconf_perf_t *g)\n{\n"
+		       "\tuint64_t buf[1 + PELCONF_PERF_COUNT];\n"
+		       "\tint i;\n\n"
+		       "\tif (g->fd[0] < 0) return;\n"
+		       "\tioctl (g->fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);\n"
+		       "\tif (read (g->fd[0], buf, sizeof buf) == (ssize_t) sizeof buf) {\n"
+		       "\t\tfor (i = 0; i < PELCONF_PERF_COUNT; ++i) g->value[i] = buf[1 + i];\n"
+		       "\t}\n"
+		       "}\n\n"
+		       "PELCONF_PERF_INLINE void pelconf_perf_close (pelconf_perf_t *g)\n{\n"
+		       "\tint i;\n\n"
+		       "\tif (g->page) munmap (g->page, (size_t) sysconf (_SC_PAGESIZE));\n"
+		       "\tif (g->fd[0] < 0) return;\n"
+		       "\tfor (i = 0; i < PELCONF_PERF_COUNT; ++i) close (g->fd[i]);\n"
+		       "\tg->fd[0] = -1;\n"
+		       "}\n\n", f);
+		fputs ("/* Read the cycles counted since pelconf_perf_start() while the group\n"
+		       "   runs. rdpmc avoids the system call if the kernel allows it. */\n"
+		       "PELCONF_PERF_INLINE uint64_t pelconf_perf_read_cycles (pelconf_perf_t *g)\n{\n"
+		       "\tuint64_t buf[1 + PELCONF_PERF_COUNT];\n", f);
+		if (have_rdpmc) {
+			fputs ("\tvolatile struct perf_event_mmap_page *pc = (struct perf_event_mmap_page *) g->page;\n"
+			       "\tuint32_t seq, idx;\n"
+			       "\tint64_t count, pmc;\n"
+			       "\tint shift;\n\n"
+			       "\tif (pc != 0 && pc->cap_user_rdpmc) {\n"
+			       "\t\tdo {\n"
+			       "\t\t\tseq = pc->lock;\n"
+			       "\t\t\t__asm__ __volatile__ (\"\" ::: \"memory\");\n"
+			       "\t\t\tidx = pc->index;\n"
+			       "\t\t\tcount = pc->offset;\n"
+			       "\t\t\tif (idx != 0) {\n"
+			       "\t\t\t\tshift = 64 - pc->pmc_width;\n"
+			       "\t\t\t\tpmc = (int64_t) __builtin_ia32_rdpmc ((int) idx - 1);\n"
+			       "\t\t\t\tcount += (int64_t) ((uint64_t) pmc << shift) >> shift;\n"
+			       "\t\t\t}\n"
+			       "\t\t\t__asm__ __volatile__ (\"\" ::: \"memory\");\n"
+			       "\t\t} while (pc->lock != seq);\n"
+			       "\t\treturn (uint64_t) count;\n"
+			       "\t}\n", f);
+		}
+		fputs ("\tif (g->fd[0] >= 0 && read (g->fd[0], buf, sizeof buf) == (ssize_t) sizeof buf) {\n"
+		       "\t\treturn buf[1];\n"
+		       "\t}\n"
+		       "\treturn 0;\n"
+		       "}\n\n"
+		       "#endif\n", f);
+	}
+	fclose (f);
+
+	if (aci_replace_if_changed (sbufchars (&tmpname), header)) {
+		printf ("Writing the counters header '%s'\n", header);
+	} else {
+		printf ("'%s' is unchanged\n", header);
+	}
+	sbuffree (&tmpname);
+}
+
+
+/* Check for <linux/perf_event.h>, the perf_event_open system call and the
+   rdpmc instruction. These checks only compile. Unless --no-run is given
+   also check if the counters can be opened on this computer. If header is
+   not NULL write it with the counter group API, or with stubs if the
+   counters are not available. Return nonzero if perf_event_open exists. */
+int ac_check_perf_events (const char *header)
+{
+	int have_h, have_perf = 0, have_rdpmc = 0, access;
+	char buf[100];
+
+	have_h = ac_does_compile ("Has <linux/perf_event.h>",
+	        "#include <linux/perf_event.h>\nstruct perf_event_attr attr;\n",
+	        NULL, "LINUX_PERF_EVENT_H");
+	if (have_h) {
+		have_perf = ac_does_compile ("Has the perf_event_open system call",
+		        ACI_GNU_SOURCE
+		        "#include <sys/syscall.h>\n#include <linux/perf_event.h>\n"
+		        "long n = SYS_perf_event_open;\n"
+		        "unsigned long long f = PERF_FORMAT_GROUP;\n",
+		        NULL, "PERF_EVENT_OPEN");
+	}
+	if (have_perf) {
+		have_rdpmc = ac_does_compile ("Has rdpmc for the perf counters",
+		        "#include <linux/perf_event.h>\n"
+		        "unsigned long long f (struct perf_event_mmap_page *pc)\n"
+		        "{ return pc->cap_user_rdpmc ? __builtin_ia32_rdpmc ((int) pc->index - 1) : 0; }\n",
+		        NULL, "PERF_RDPMC");
+		if (!aci_no_run) {
+			access = aci_build_and_run (aci_perf_open_test, NULL, NULL, buf, sizeof buf);
+			printf ("Can open the hardware counters here: %s\n", aci_noyes[access]);
+			fflush (stdout);
+		}
+	}
+
+	if (header != NULL) {
+		aci_write_perf_header (header, have_perf, have_rdpmc);
+	}
+	return have_perf;
+}
+
+
+/* The flags that enable OpenMP, in order of preference. */
+static const char *aci_openmp_flags[] = { "-fopenmp", "-fopenmp=libomp", "-qopenmp", "-openmp" };
+
+static const char aci_openmp_test[] =
+	"#include <omp.h>\n"
+	"int main (void)\n{\n"
+	"\tint n = 0;\n"
+	"#pragma omp parallel reduction(+:n)\n"
+	"\tn += 1;\n"
+	"\treturn omp_get_max_threads () > 0 && n > 0 ? 0 : 1;\n}\n";
+
+static const char aci_tbb_test[] =
+	"#include <tbb/parallel_for.h>\n"
+	"int main () { int n[100] = { 0 };\n"
+	"    tbb::parallel_for (0, 100, [&n] (int i) { n[i] = i; }); return n[99] - 99; }\n";
+
+/* Print the number of threads used by std::for_each and the number of
+   processors. */
+static const char aci_pstl_test[] =
+	"#include <algorithm>\n#include <execution>\n#include <vector>\n"
+	"#include <thread>\n#include <mutex>\n#include <set>\n#include <cstdio>\n"
+	"int main ()\n{\n"
+	"\tstd::vector<int> v (1 << 16);\n"
+	"\tstd::set<std::thread::id> ids;\n"
+	"\tstd::mutex m;\n"
+	"\tstd::for_each (std::execution::par, v.begin (), v.end (), [&] (int &x) {\n"
+	"\t\tx = 1;\n"
+	"\t\tstd::lock_guard<std::mutex> g (m);\n"
+	"\t\tids.insert (std::this_thread::get_id ());\n"
+	"\t});\n"
+	"\tstd::printf (\"%d %d\\n\", (int) ids.size (), (int) std::thread::hardware_concurrency ());\n"
+	"\treturn 0;\n}\n";
+
+
+/* The parallel algorithms of libstdc++ are built on TBB. */
+static const char aci_execution_test[] =
+	"#include <algorithm>\n#include <execution>\n#include <vector>\n"
+	"int main () { std::vector<int> v (1000, 1);\n"
+	"    std::sort (std::execution::par_unseq, v.begin (), v.end ()); return v[0] - 1; }\n";
+
+/* Result of aci_check_cxx_execution: -1 if not checked yet, 0 if the
+   parallel algorithms do not link, 1 if they link alone and 2 if they need
+   TBB. */
+static int aci_cxx_execution = -1;
+
+
+/* Check if the parallel algorithms link, first alone and then with -ltbb.
+   The library goes to CXX_EXECUTION_LIBS and not to EXTRALIBS because most
+   programs do not use them. The check is done once. Return the result in
+   the format of aci_cxx_execution. */
+static int aci_check_cxx_execution (void)
+{
+	int res, tbb = 0;
+	sbuf_t sb;
+
+	if (aci_cxx_execution >= 0) {
+		return aci_cxx_execution;
+	}
+
+	ac_set_var ("CXX_EXECUTION_LIBS", "");
+	res = aci_can_compile_link (aci_execution_test, NULL, NULL, 0);
+	printf ("Has C++17 parallel algorithms: %s\n", aci_noyes[res]);
+	fflush (stdout);
+	if (!res) {
+		res = tbb = aci_can_compile_link (aci_execution_test, NULL, "tbb", 0);
+		printf ("Has C++17 parallel algorithms with -ltbb: %s\n", aci_noyes[res]);
+		fflush (stdout);
+		if (res) {
+			sbufinit (&sb);
+			sbufformat (&sb, 1, "%stbb%s", aci_lib_prefix, aci_lib_suffix);
+			ac_set_var ("CXX_EXECUTION_LIBS", sbufchars (&sb));
+			sbuffree (&sb);
+		}
+	}
+	ac_add_flag ("CXX_EXECUTION", "Has C++17 parallel algorithms", res);
+	ac_add_flag ("CXX_EXECUTION_NEEDS_TBB", "The parallel algorithms need -ltbb", tbb);
+	aci_cxx_execution = res + tbb;
+	return aci_cxx_execution;
+}
+
+
+/* Find the flag that enables OpenMP and set OPENMP_CFLAGS and OPENMP_LIBS.
+   In C++ look for TBB with pkg-config or as the library tbb and set
+   TBB_CFLAGS and TBB_LIBS. The parallel algorithms use the result of
+   aci_check_cxx_execution and PSTL_LIBS is CXX_EXECUTION_LIBS. Unless
+   --no-run is given check that std::for_each() with std::execution::par
+   uses several threads. The
+   libraries are not added to EXTRALIBS. Return the number of runtimes
+   found. */
+int ac_check_parallel_runtimes (void)
+{
+	size_t i;
+	int res, threads, cpus, count = 0;
+	sbuf_t cflags, libs;
+	char buf[100];
+
+	sbufinit (&cflags);
+	sbufinit (&libs);
+
+	ac_set_var ("OPENMP_CFLAGS", "");
+	ac_set_var ("OPENMP_LIBS", "");
+	res = 0;
+	for (i = 0; i < sizeof aci_openmp_flags / sizeof aci_openmp_flags[0] && !res; ++i) {
+		res = aci_can_compile_link (aci_openmp_test, aci_openmp_flags[i], NULL, 0);
+		printf ("Has OpenMP with %s: %s\n", aci_openmp_flags[i], aci_noyes[res]);
+		if (res) {
+			/* The flag also links the runtime. */
+			ac_set_var ("OPENMP_CFLAGS", aci_openmp_flags[i]);
+			ac_set_var ("OPENMP_LIBS", aci_openmp_flags[i]);
+		}
+	}
+	ac_add_flag ("OPENMP", "Has OpenMP with omp_get_max_threads()", res);
+	count += res;
+	fflush (stdout);
+
+	if (!aci_need_cxx_check) {
+		goto clean;
+	}
+
+	ac_set_var ("TBB_CFLAGS", "");
+	ac_set_var ("TBB_LIBS", "");
+	if (ac_has_pkg_config () && ac_pkg_config_query ("tbb", &cflags, &libs) == 0) {
+		res = aci_can_compile_link (aci_tbb_test, sbufchars (&cflags), sbufchars (&libs), 1);
+		printf ("Has TBB with pkg-config: %s\n", aci_noyes[res]);
+	} else {
+		sbufclear (&cflags);
+		sbufformat (&libs, 1, "%stbb%s", aci_lib_prefix, aci_lib_suffix);
+		res = aci_can_compile_link (aci_tbb_test, NULL, "tbb", 0);
+		printf ("Has TBB: %s\n", aci_noyes[res]);
+	}
+	ac_add_flag ("TBB", "Has TBB", res);
+	if (res) {
+		ac_set_var ("TBB_CFLAGS", sbufchars (&cflags));
+		ac_set_var ("TBB_LIBS", sbufchars (&libs));
+		res = aci_can_compile ("#include <oneapi/tbb/version.h>\n", sbufchars (&cflags));
+		printf ("Has oneTBB: %s\n", aci_noyes[res]);
+		ac_add_flag ("ONETBB", "Has oneTBB", res);
+		++count;
+	}
+	fflush (stdout);
+
+	/* The same result as HAVE_CXX_EXECUTION. */
+	res = aci_check_cxx_execution ();
+	ac_set_var ("PSTL_LIBS", "$(CXX_EXECUTION_LIBS)");
+	ac_add_flag ("PSTL", "Has the parallel algorithms", res != 0);
+	count += res != 0;
+
+	threads = 0;
+	if (res && !aci_no_run) {
+		if (aci_build_and_run (aci_pstl_test, NULL, res == 2 ? "tbb" : NULL, buf, sizeof buf)
+		        && sscanf (buf, "%d %d", &threads, &cpus) == 2) {
+			if (cpus <= 1) {
+				printf ("The parallel algorithms run in parallel: unknown with one processor\n");
+				threads = 0;
+			} else {
+				printf ("The parallel algorithms run in parallel: %s, %d threads\n",
+				        aci_noyes[threads > 1], threads);
+			}
+		}
+	}
+	ac_add_flag ("PSTL_PARALLEL", "The parallel algorithms run in parallel", threads > 1);
+	fflush (stdout);
+
+clean:
+	sbuffree (&cflags);
+	sbuffree (&libs);
+	return count;
+}
+
+
+/* Check for the presence of ssize_t and typedef it otherwise. */
+static void aci_check_ssize (void)
+{
+	if (aci_can_compile ("#include <unistd.h>\nssize_t x;\n", "")) {
+		ac_add_code ("#include <unistd.h>", 1);
+	} else {
+		sbuf_t sb;
+		int szu = aci_check_sizeof ("stddef.h", "", "size_t", 0);
+		int szi = aci_check_sizeof ("stddef.h", "", "ptrdiff_t", 0);
+		if (szu == 0) {
+			printf ("could not find the size of size_t\n");
+			exit (1);
+		}
+		if (szu == szi) {
+			ac_add_code ("typedef ptrdiff_t ssize_t;", 1);
+		} else {
+			sbufinit (&sb);
+			sbufformat (&sb, 0, "typedef int_least%d_t ssize_t;", szu * 8);
+			ac_add_code (sbufchars (&sb), 1);
+			sbuffree (&sb);
+		}
+	}
+}
+
+
+/* Check for the unicode types char16_t and char32_t. */
+static void aci_check_char32 (void)
+{
+	sbuf_t sb;
+	ac_has_type ("", NULL, "char32_t");
+	ac_has_type_tag ("uchar.h", NULL, "char32_t", "CHAR32_T_IN_UCHAR_H");
+	ac_has_headers ("cuchar", NULL);
+
+	/* Ensure that wchar_t is always distinct from char16_t and char32_t.
+	   This is what the C++11 standard says.
+	*/
+
+	sbufinit (&sb);
+	sbufcpy (&sb,
+	        "#ifndef HAVE_CHAR32_T\n"
+			"  #ifdef CHAR32_T_IN_UCHAR_H\n"
+			"    #include <uchar.h>\n"
+			"  #elif defined(HAVE_CUCHAR)\n"
+			"    #include <cuchar>\n"
+			"  #elif !defined(__STDC_UTF_32__)\n");
+
+	sbufcat (&sb,
+	        "    typedef uint_least16_t char16_t;\n"
+			"    typedef uint_least32_t char32_t;\n");
+
+
+	sbufcat (&sb,
+	        "    #define __STDC_UTF_32__\n"
+			"    #define __STDC_UTF_16__\n"
+			"  #endif\n"
+			"#endif\n\n");
+
+	ac_add_code (sbufchars (&sb), 1);
+
+	if (ac_does_compile ("Has U\"text\" support",
+	                      "const void *p = U\"text\";\n",
+	                      NULL, "NATIVE_U_ESCAPE")) {
+		ac_add_code ("#ifndef UCS\n#define UCS(X) U##X\n#endif\n", 1);
+		ac_add_code ("#ifndef __cpp_unicode_literals\n"
+				 "  #define __cpp_unicode_literals 200710\n"
+				 "#endif\n", 1);
+	} else if (ac_get_sizeof ("stddef.h", NULL, "wchar_t") == 4) {
+		ac_add_code ("#ifndef UCS\n#define UCS(X) ((const char32_t*)L##X)\n#endif\n", 1);
+	} else {
+		printf ("can't find a suitable definition for UCS-4 encoded string literals.\n");
+	}
+
+	sbuffree (&sb);
+	fflush (stdout);
+}
+
+
+static void aci_check_c11_atomics (void)
+{
+	ac_does_compile ("Has native support for atomic_size_t",
+	      "#include <stdatomic.h>\natomic_size_t x = 0;\n", NULL, "ATOMIC_SIZE_T");
+
+	ac_does_compile ("Has atomic_load_explicit",
+	      "#include <stddef.h>\n#include <stdatomic.h>\n"
+		  "atomic_int x = 0;\n"
+		  "size_t foo (void) { return atomic_load_explicit (&x, memory_order_acquire); }\n",
+		  NULL, "ATOMIC_LOAD_EXPLICIT");
+
+	ac_does_compile ("Has atomic_store_explicit",
+	      "#include <stddef.h>\n#include <stdatomic.h>\n"
+		  "atomic_int x = 0;\n"
+		  "void foo (size_t v) { atomic_store_explicit (&x, v, memory_order_release); }\n",
+		  NULL, "ATOMIC_STORE_EXPLICIT");
+
+	ac_does_compile ("Has atomic_exchange_explicit",
+	      "#include <stddef.h>\n#include <stdatomic.h>\n"
+		  "atomic_int x = 0;\n"
+		  "size_t foo (size_t v) { return atomic_exchange_explicit (&x, v, memory_order_acq_rel); }\n",
+		  NULL, "ATOMIC_EXCHANGE_EXPLICIT");
+
+	ac_does_compile ("Has atomic_compare_exchange_weak_explicit",
+	      "#include <stddef.h>\n#include <stdatomic.h>\n"
+		  "atomic_int x = 0;\n"
+		  "int foo (int v) { \n"
+		  "   int expected = 1;\n"
+		  "   return atomic_compare_exchange_weak_explicit (&x, &expected, v, memory_order_acq_rel, memory_order_relaxed);\n"
+		  "}\n",
+		  NULL, "ATOMIC_COMPARE_EXCHANGE_WEAK_EXPLICIT");
+
+	ac_does_compile ("Has atomic_fetch_add_explicit",
+	      "#include <stddef.h>\n#include <stdatomic.h>\n"
+		  "atomic_int x = 0;\n"
+		  "size_t foo (size_t v) { \n"
+		  "   return atomic_fetch_add_explicit (&x, v, memory_order_relaxed);\n"
+		  "}\n",
+		  NULL, "ATOMIC_FETCH_ADD_EXPLICIT");
+
+	ac_does_compile ("Has atomic_fetch_sub_explicit",
+	      "#include <stddef.h>\n#include <stdatomic.h>\n"
+		  "atomic_int x = 0;\n"
+		  "size_t foo (size_t v) { \n"
+		  "   return atomic_fetch_sub_explicit (&x, v, memory_order_acq_rel);\n"
+		  "}\n",
+		  NULL, "ATOMIC_FETCH_SUB_EXPLICIT");
+}
+
+
+static void aci_check_cxx11_atomics (void)
+{
+	ac_does_compile ("Has std::atomic_load_explicit",
+	      "#include <stddef.h>\n#include <atomic>\n"
+		  "std::atomic_int x (0);\n"
+		  "size_t foo (void) { return std::atomic_load_explicit (&x, std::memory_order_acquire); }\n",
+		  NULL, "CXX_ATOMIC_LOAD_EXPLICIT");
+
+	ac_does_compile ("Has std::atomic_store_explicit",
+	      "#include <stddef.h>\n#include <atomic>\n"
+		  "std::atomic_int x (0);\n"
+		  "void foo (size_t v) { std::atomic_store_explicit (&x, v, std::memory_order_release); }\n",
+		  NULL, "CXX_ATOMIC_STORE_EXPLICIT");
+
+	ac_does_compile ("Has std::atomic_exchange_explicit",
+	      "#include <stddef.h>\n#include <atomic>\n"
+		  "std::atomic_int x (0);\n"
+		  "size_t foo (size_t v) { return std::atomic_exchange_explicit (&x, v, std::memory_order_acq_rel); }\n",
+		  NULL, "CXX_ATOMIC_EXCHANGE_EXPLICIT");
+
+	ac_does_compile ("Has std::atomic_compare_exchange_weak_explicit",
+	      "#include <stddef.h>\n#include <atomic>\n"
+		  "std::atomic_int x (0);\n"
+		  "int foo (int v) { \n"
+		  "   int expected = 1;\n"
+		  "   return std::atomic_compare_exchange_weak_explicit (&x, &expected, v, std::memory_order_acq_rel, std::memory_order_relaxed);\n"
+		  "}\n",
+		  NULL, "CXX_ATOMIC_COMPARE_EXCHANGE_WEAK_EXPLICIT");
+
+	ac_does_compile ("Has std::atomic_fetch_add_explicit",
+	      "#include <stddef.h>\n#include <atomic>\n"
+		  "std::atomic_int x (0);\n"
+		  "size_t foo (size_t v) { \n"
+		  "   return std::atomic_fetch_add_explicit (&x, v, std::memory_order_relaxed);\n"
+		  "}\n",
+		  NULL, "CXX_ATOMIC_FETCH_ADD_EXPLICIT");
+
+	ac_does_compile ("Has std::atomic_fetch_sub_explicit",
+	      "#include <stddef.h>\n#include <atomic>\n"
+		  "std::atomic_size_t x (0);\n"
+		  "size_t foo (size_t v) { \n"
+		  "   return std::atomic_fetch_sub_explicit (&x, v, std::memory_order_acq_rel);\n"
+		  "}\n",
+		  NULL, "CXX_ATOMIC_FETCH_SUB_EXPLICIT");
+}
+
+
+/* Check which sizes of atomic variables are always lock free, how the 16
+   byte compare and swap is done and if libatomic is needed. Also check the
+   C11 atomic functions in C, or the C++11 ones and the C++20 additions in
+   C++. Return the size of the
+   largest lock free type. */
+int ac_check_atomics (void)
+{
+	/* C only has lock free macros up to long long. */
+	static const char *c_tests[] = { "ATOMIC_CHAR_LOCK_FREE == 2", "ATOMIC_SHORT_LOCK_FREE == 2",
+	        "ATOMIC_INT_LOCK_FREE == 2", "ATOMIC_LLONG_LOCK_FREE == 2",
+	        "__atomic_always_lock_free (16, 0)" };
+	static const char *cas16_flags[] = { "", "-mcx16" };
+	static const char cas_src[] =
+		"struct s16 { long long a, b; } __attribute__((aligned(16)));\n"
+		"struct s16 x16;\n"
+		"unsigned long long x8;\n"
+		"int main (void) {\n"
+		"    struct s16 e16 = { 0, 0 }, d16 = { 1, 1 };\n"
+		"    unsigned long long e8 = 0;\n"
+		"    return __atomic_compare_exchange (&x16, &e16, &d16, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)\n"
+		"        + __atomic_compare_exchange_n (&x8, &e8, 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);\n"
+		"}\n";
+	size_t i;
+	int n, largest = 0, inline16 = 0;
+	sbuf_t src, cmt, tag;
+
+	sbufinit (&src);
+	sbufinit (&cmt);
+	sbufinit (&tag);
+
+	for (n = 1, i = 0; n <= 16; n *= 2, ++i) {
+		sbufformat (&src, 1, "#ifdef __cplusplus\n"
+		            "#include <atomic>\n"
+		            "struct s { char c[%d]; };\n"
+		            "char dummy[std::atomic<s>::is_always_lock_free ? 1 : -1];\n"
+		            "#else\n"
+		            "#include <stdatomic.h>\n"
+		            "char dummy[%s ? 1 : -1];\n"
+		            "#endif\n", n, c_tests[i]);
+		sbufformat (&cmt, 1, "Are the atomic variables of %d bytes always lock free", n);
+		sbufformat (&tag, 1, "ATOMIC_LOCK_FREE_%d", n);
+		if (ac_does_compile (sbufchars (&cmt), sbufchars (&src), NULL, sbufchars (&tag))) {
+			largest = n;
+		}
+	}
+
+	/* GCC only inlines cmpxchg16b for the __sync builtins. */
+	for (i = 0; i < sizeof cas16_flags / sizeof cas16_flags[0] && !inline16; ++i) {
+		inline16 = aci_can_compile_link (
+		        "__int128 x;\n"
+		        "int main (void) { return __sync_bool_compare_and_swap (&x, (__int128) 0, (__int128) 1); }\n",
+		        cas16_flags[i], NULL, 0);
+		if (inline16) {
+			ac_set_var ("ATOMIC_CAS16_CFLAGS", cas16_flags[i]);
+		}
+	}
+	ac_add_flag ("ATOMIC_CAS16_INLINE", "Is the compare and swap of 16 bytes done inline", inline16);
+	printf ("Is the compare and swap of 16 bytes done inline: %s\n", aci_noyes[inline16]);
+	fflush (stdout);
+
+	if (ac_does_compile_and_link ("Do the atomic builtins link without libatomic", cas_src,
+	                              NULL, NULL, "ATOMIC_WITHOUT_LIBATOMIC")) {
+		ac_add_flag ("ATOMIC_NEEDS_LIBATOMIC", "Do the atomic builtins need libatomic", 0);
+	} else {
+		ac_does_compile_and_link ("Do the atomic builtins need libatomic", cas_src,
+		                          NULL, "atomic", "ATOMIC_NEEDS_LIBATOMIC");
+	}
+
+	if (!aci_need_cxx_check) {
+		aci_check_c11_atomics ();
+	} else {
+		aci_check_cxx11_atomics ();
+
+		ac_does_compile_and_link ("Has std::atomic_ref",
+		      "#include <atomic>\n"
+		      "int x;\n"
+		      "int main () { std::atomic_ref<int> r (x); return r.fetch_add (1); }\n",
+		      NULL, NULL, "CXX_ATOMIC_REF");
+
+		ac_does_compile_and_link ("Has std::atomic<T>::wait() and notify_one()",
+		      "#include <atomic>\n"
+		      "std::atomic<int> x (0);\n"
+		      "int main () { x.notify_one (); x.wait (1); return 0; }\n",
+		      NULL, NULL, "CXX_ATOMIC_WAIT");
+	}
+
+	sbuffree (&src);
+	sbuffree (&cmt);
+	sbuffree (&tag);
+	return largest;
+}
+
+
+/* Check for a bunch of features in one go. */
+static void aci_check_misc_once (void)
+{
+	int has_func_name, has_att;
+	sbuf_t sb;
+
+	sbufinit (&sb);
+
+	/* Enable GNU __attribute__ syntax. */
+	has_att = ac_does_compile ("Has native support for __attribute__(()) syntax",
+	    "__attribute__((unused)) void foo(void);\n", NULL, "GCC_ATTRIBUTE");
+
+	aci_check_thread_local ();
+	aci_check_align_keyword ();
+	aci_check_stdbool ();
+	aci_check_restrict_keyword ();
+	aci_check_va_copy ();
+	aci_check_variadic_macros ();
+	aci_check_flexible_array_member ();
+	aci_check_some_inttypes ();
+	if (!aci_need_cxx_check) {
+		aci_check_mixed_code_vars ();
+	}
+	aci_check_ssize ();
+	aci_check_char32 ();
+/* Not mature enough, yet. */
+/* aci_check_c11_atomics (); */
+	aci_check_builtin_overflow();
+
+	aci_flag_list_add (&aci_flags_root, "WINDOWS", "Are we running MS-Windows", aci_have_windows);
+
+	if (aci_have_windows) {
+		if (aci_have_function_proto ("sys/cygwin.h", NULL, "cygwin_conv_to_win32_path")) {
+			aci_flag_list_add (&aci_flags_root, "CYGWIN", "Are we running under Cygwin", 1);
+			aci_have_cygwin = 1;
+		}
+	}
+
+	if (aci_check_define (NULL, NULL, "__MINGW32__")) {
+		 printf ("detected mingw\n");
+		 fflush (stdout);
+		 ac_has_compiler_flag ("-posix", "GCC_POSIX");
+	}
+
+
+
+	if (aci_have_windows) {
+		ac_set_var ("EXE", ".exe");
+		if (!has_att) {
+			aci_attsyn[0] = "__declspec(%s)";
+			has_att = 1;
+		}
+	} else {
+		ac_set_var ("EXE", "");
+	}
+
+
+	if (!has_att) {
+		if (aci_have_windows) {
+			ac_add_code ("#define __attribute__(x) __declspec x\n", 1);
 		} else {
 			ac_add_code ("#define __attribute__(x)\n", 1);
 		}
@@ -4250,6 +6268,96 @@ static void aci_check_constexpr (void)
 			 "#endif\n", 1);
 }
 
+/* C++17 and C++20 features used in hot paths. Library features must also
+   link. The programs are compiled with the version of the language chosen. */
+static const struct {
+	const char *tag;
+	const char *comment;
+	int link;
+	const char *src;
+} aci_modern_cxx_checks[] = {
+	{ "CXX_IF_CONSTEXPR", "Has C++17 if constexpr", 0,
+	  "template <class T> int f (T x) { if constexpr (sizeof (T) > 4) return 8; else return (int) x; }\n"
+	  "int g (void) { return f (1) + f (1.0); }\n" },
+	{ "CXX_PMR", "Has C++17 std::pmr memory resources", 1,
+	  "#include <memory_resource>\n#include <vector>\n"
+	  "int main () { char buf[256]; std::pmr::monotonic_buffer_resource r (buf, sizeof buf);\n"
+	  "    std::pmr::vector<int> v (&r); v.push_back (1); return v[0] - 1; }\n" },
+	{ "CXX_CHARCONV", "Has C++17 std::from_chars and std::to_chars", 1,
+	  "#include <charconv>\n"
+	  "int main () { char buf[32]; int x = 0; std::to_chars_result r = std::to_chars (buf, buf + 32, 42);\n"
+	  "    std::from_chars (buf, r.ptr, x); return x - 42; }\n" },
+	{ "CXX_CHARCONV_FLOAT", "Has std::from_chars and std::to_chars for double", 1,
+	  "#include <charconv>\n"
+	  "int main () { char buf[64]; double x = 0; std::to_chars_result r = std::to_chars (buf, buf + 64, 0.5);\n"
+	  "    std::from_chars (buf, r.ptr, x); return x != 0.5; }\n" },
+	{ "CXX_BIT", "Has C++20 <bit> with std::popcount and std::countl_zero", 0,
+	  "#include <bit>\n"
+	  "int f (unsigned x) { return std::popcount (x) + std::countl_zero (x); }\n" },
+	{ "CXX_SPAN", "Has C++20 std::span", 0,
+	  "#include <span>\n"
+	  "int f (std::span<const int> s) { return s.empty () ? 0 : s[0]; }\n"
+	  "int g (void) { int a[2] = { 1, 2 }; return f (a); }\n" },
+	{ "CXX_JTHREAD", "Has C++20 std::jthread and std::latch", 1,
+	  "#include <thread>\n#include <latch>\n"
+	  "int main () { std::latch l (1); std::jthread t ([&l] { l.count_down (); }); l.wait (); return 0; }\n" },
+	{ "CXX_ASSUME_ALIGNED", "Has C++20 std::assume_aligned", 0,
+	  "#include <memory>\n"
+	  "int f (int *p) { return *std::assume_aligned<64> (p); }\n" }
+};
+
+
+/* C++20 coroutines need -fcoroutines in GCC 10. */
+static const char aci_coroutine_test[] =
+	"#include <coroutine>\n"
+	"struct task {\n"
+	"    struct promise_type {\n"
+	"        task get_return_object () { return task (); }\n"
+	"        std::suspend_never initial_suspend () { return std::suspend_never (); }\n"
+	"        std::suspend_never final_suspend () noexcept { return std::suspend_never (); }\n"
+	"        void return_void () {}\n"
+	"        void unhandled_exception () {}\n"
+	"    };\n"
+	"};\n"
+	"task f () { co_return; }\n";
+
+
+/* Check for the C++17 and C++20 features that help in hot paths. */
+static void aci_check_modern_cxx (void)
+{
+	int i, res, n = (int) (sizeof aci_modern_cxx_checks / sizeof aci_modern_cxx_checks[0]);
+
+	for (i = 0; i < n; ++i) {
+		if (aci_modern_cxx_checks[i].link) {
+			ac_does_compile_and_link (aci_modern_cxx_checks[i].comment,
+			        aci_modern_cxx_checks[i].src, NULL, NULL, aci_modern_cxx_checks[i].tag);
+		} else {
+			ac_does_compile (aci_modern_cxx_checks[i].comment,
+			        aci_modern_cxx_checks[i].src, NULL, aci_modern_cxx_checks[i].tag);
+		}
+	}
+
+	/* The flags of the second attempts are only for the programs that use
+	   the feature, so they go to their own variables and not to EXTRA_CFLAGS
+	   or EXTRALIBS. */
+	ac_set_var ("CXX_COROUTINES_CFLAGS", "");
+	res = aci_can_compile (aci_coroutine_test, NULL);
+	printf ("Has C++20 coroutines: %s\n", aci_noyes[res]);
+	fflush (stdout);
+	if (!res) {
+		res = aci_can_compile (aci_coroutine_test, "-fcoroutines");
+		printf ("Has C++20 coroutines with -fcoroutines: %s\n", aci_noyes[res]);
+		fflush (stdout);
+		if (res) {
+			ac_set_var ("CXX_COROUTINES_CFLAGS", "-fcoroutines");
+		}
+	}
+	ac_add_flag ("CXX_COROUTINES", "Has C++20 coroutines", res);
+
+	aci_check_cxx_execution ();
+}
+
+
 
 /* Perform all C++ specific checks. */
 static void aci_check_cxx (void)
@@ -4269,6 +6377,7 @@ static void aci_check_cxx (void)
 	aci_check_constexpr();
 	aci_check_auto();
 	aci_check_abi_tag();
+	aci_check_modern_cxx ();
 /*  ac_check_each_header_sequence("type_traits chrono tuple system_error ratio atomic thread", ""); */
 }
 
@@ -4600,6 +6709,16 @@ static const char aci_stdver[] = "stdver";
 static const char aci_nostdver[] = "nostdver";
 static const char aci_simple_name[] = "simple";
 static const char aci_static_name[] = "static";
+static const char aci_manifest_name[] = "manifest";
+static const char aci_x86_64_levels_name[] = "x86-64-levels";
+static const char aci_linker_name[] = "linker";
+static const char aci_compiler_cache_name[] = "with-compiler-cache";
+static const char aci_optimize_startup_name[] = "optimize-startup";
+static const char aci_so_direct_calls_name[] = "so-direct-calls";
+static const char aci_allocator_name[] = "with-allocator";
+static const char aci_target_cpu_topology_name[] = "target-cpu-topology";
+static const char aci_no_run_name[] = "no-run";
+static int aci_optimize_startup = 0;
 static int aci_use_stdver = 0;
 
 
@@ -4620,6 +6739,15 @@ void aci_usage (const char *progname)
 	printf ("--%s will select the default version of the language as provided by the compiler\n", aci_nostdver);
 	printf ("--%s will choose simple command line options for GCC which are not likely to be buggy\n", aci_simple_name);
 	printf ("--%s will use static linking when probing.\n", aci_static_name);
+	printf ("--%s=file will run the probes listed in the given manifest file.\n", aci_manifest_name);
+	printf ("--%s will check which x86-64 micro-architecture levels (v2, v3, v4) can be built.\n", aci_x86_64_levels_name);
+	printf ("--%s=name will link with the given linker (mold, lld, gold, bfd or default). Default is the fastest one available.\n", aci_linker_name);
+	printf ("--%s will add the flags that reduce the size and the startup time of the programs.\n", aci_optimize_startup_name);
+	printf ("--%s will bind the calls inside of shared libraries directly, without the PLT.\n", aci_so_direct_calls_name);
+	printf ("--%s=name will link with the allocator jemalloc, tcmalloc or mimalloc.\n", aci_allocator_name);
+	printf ("--%s=line=64,l1d=32K,l2=1M,l3=32M,cores=8,threads=16 gives the CPU topology of the target.\n", aci_target_cpu_topology_name);
+	printf ("--%s will not run the benchmarks and will use the default choices. Cross compiling implies it.\n", aci_no_run_name);
+	printf ("--%s[=name] will build with a compiler cache (ccache or sccache). The tests never use it.\n", aci_compiler_cache_name);
 	printf ("--prefix=name will use the given prefix for the generation of INSTALL_INCLUDE and INSTALL_LIB make variables\n");
 	printf ("--with-extra-includes <name> will use the given additional include directories\n");
 	printf ("--with-extra-libs <name> will use the given additional library directories\n");
@@ -5133,32 +7261,410 @@ done:
 */
 static void aci_get_prefix(void)
 {
-	char pfx[FILENAME_MAX];
-	ptrdiff_t n = ac_has_feature ("prefix", pfx, sizeof pfx);
+	char pfx[FILENAME_MAX];
+	ptrdiff_t n = ac_has_feature ("prefix", pfx, sizeof pfx);
+
+	if (n > 0 && n < (ptrdiff_t)(sizeof pfx) + 1) {
+		if (pfx[n - 1] != '/') {
+			pfx[n] = '/';
+			pfx[n + 1] = 0;
+		}
+		ac_set_var ("PREFIX", pfx);
+		strcpy (aci_install_prefix, pfx);
+	} else if (aci_have_windows && !aci_have_cygwin) {
+		if (aci_locate_windows_compiler (aci_compile_cmd, pfx, sizeof pfx) == 0) {
+			strcat (pfx, "local/");
+			ac_set_var ("PREFIX", pfx);
+			strcpy (aci_install_prefix, pfx);
+		} else {
+			ac_set_var ("PREFIX", "/usr/local/");
+			strcpy (aci_install_prefix, "/usr/local/");
+		}
+	} else {
+		ac_set_var ("PREFIX", "/usr/local/");
+		strcpy (aci_install_prefix, "/usr/local/");
+	}
+	if (strchr (aci_install_prefix, ' ') != NULL) {
+		aci_install_prefix_spaces = 1;
+	}
+}
+
+
+/* Linkers that are faster than the default one, in order of preference. */
+static const char *aci_fast_linkers[] = { "mold", "lld", "gold", NULL };
+
+/* The option that sets the number of threads of each linker. lld 11 and
+   later reject --threads without a value and gold needs --threads to use
+   --thread-count. */
+static const struct {
+	const char *name, *option;
+} aci_linker_threads[] = {
+	{ "mold", "-Wl,--thread-count=%d" },
+	{ "lld", "-Wl,--threads=%d" },
+	{ "gold", "-Wl,--threads -Wl,--thread-count=%d" }
+};
+
+/* Check if the linker selected by fuse_ld accepts the option flag. If it
+   does then store flag in the makefile variable makevar. */
+static int aci_has_linker_flag (const char *fuse_ld, const char *flag, const char *makevar)
+{
+	sbuf_t sb;
+	int result;
+
+	sbufinit (&sb);
+	sbufformat (&sb, 1, "%s %s", fuse_ld, flag);
+	printf ("Does the linker accept the option %s ", flag);
+	result = aci_can_compile_link ("int main () { return 0; }\n", sbufchars (&sb), NULL, 0);
+	if (result) {
+		ac_set_var (makevar, flag);
+	}
+	printf ("%s\n", aci_noyes[result]);
+	fflush (stdout);
+	sbuffree (&sb);
+	return result;
+}
+
+
+/* Select the linker. If linker is NULL then the first of aci_fast_linkers
+   which works is used. The option for the linker goes to FAST_LD and is also
+   used for the rest of the link tests. */
+static void aci_check_fast_ld (const char *linker)
+{
+	sbuf_t sb, threads;
+	int i, found = 0;
+	size_t j;
+	long cpus = 0;
+	char buf[256];
+
+	ac_set_var ("FAST_LD", "");
+	ac_set_var ("FAST_LD_THREADS", "");
+	if (linker != NULL && strcmp (linker, "default") == 0) {
+		return;
+	}
+
+	sbufinit (&sb);
+	if (linker != NULL) {
+		sbufformat (&sb, 1, "-fuse-ld=%s", linker);
+		found = ac_has_compiler_flag (sbufchars (&sb), "FAST_LD");
+		if (!found) {
+			ac_msg_error ("the linker given with --linker does not work");
+		}
+	} else {
+		for (i = 0; !found && aci_fast_linkers[i] != NULL; ++i) {
+			linker = aci_fast_linkers[i];
+			sbufformat (&sb, 1, "-fuse-ld=%s", linker);
+			found = ac_has_compiler_flag (sbufchars (&sb), "FAST_LD");
+		}
+	}
+
+	if (found) {
+		/* Use as many threads as processors has this computer. */
+		if (aci_read_line_file ("/sys/devices/system/cpu/online", buf, sizeof buf)) {
+			cpus = aci_count_cpu_list (buf);
+		}
+		for (j = 0; cpus > 1 && j < sizeof aci_linker_threads / sizeof aci_linker_threads[0]; ++j) {
+			if (strcmp (linker, aci_linker_threads[j].name) == 0) {
+				sbufinit (&threads);
+				sbufformat (&threads, 1, aci_linker_threads[j].option, (int) cpus);
+				aci_has_linker_flag (sbufchars (&sb), sbufchars (&threads), "FAST_LD_THREADS");
+				sbuffree (&threads);
+			}
+		}
+		/* Only the link tests get the option. Clang with -Werror rejects
+		   -fuse-ld when it only compiles. */
+		sbufcat (&aci_link_testing_flags, " ");
+		sbufcat (&aci_link_testing_flags, sbufchars (&sb));
+		ac_add_var_append ("LDFLAGS", "$(FAST_LD) $(FAST_LD_THREADS)");
+		ac_add_var_append ("SO_LDFLAGS", "$(FAST_LD) $(FAST_LD_THREADS)");
+		ac_add_var_append ("PIE_LDFLAGS", "$(FAST_LD) $(FAST_LD_THREADS)");
+	}
+	sbuffree (&sb);
+}
+
+
+/* Compiler caches and the first version which caches the objects compiled
+   with -gsplit-dwarf. */
+static const struct {
+	const char *name;
+	int split_dwarf_major, split_dwarf_minor;
+} aci_compiler_caches[] = {
+	{ "ccache", 3, 2 },
+	{ "sccache", 0, 4 },
+	{ NULL, 0, 0 }
+};
+
+/* Get the version of the program that has just been run with --version. */
+static void aci_read_version (int *major, int *minor)
+{
+	FILE *f;
+	sbuf_t sb;
+	const char *cp;
+
+	*major = *minor = 0;
+	f = fopen (aci_stdout_dummy, "r");
+	if (f == NULL) {
+		return;
+	}
+	sbufinit (&sb);
+	sbufgets (&sb, f);
+	fclose (f);
+
+	cp = sbufchars (&sb);
+	while (*cp && !isdigit ((unsigned char)*cp)) {
+		++cp;
+	}
+	sscanf (cp, "%d.%d", major, minor);
+	sbuffree (&sb);
+}
+
+
+/* Look for a compiler cache that works with the compiler and the testing
+   flags. If name is NULL then try all the known ones. The cache is only
+   prepended to CC and CXX of the makefile. The tests keep using the bare
+   compiler so that their results never come from the cache. */
+static void aci_check_compiler_cache (const char *name)
+{
+	sbuf_t cmd;
+	const char *saved_cmd;
+	aci_varnode_t *vn;
+	int i, major, minor, works;
+
+	sbufinit (&cmd);
+	for (i = 0; aci_compiler_caches[i].name != NULL; ++i) {
+		if (name != NULL && strcmp (name, aci_compiler_caches[i].name) != 0) {
+			continue;
+		}
+		if (!aci_has_program (aci_compiler_caches[i].name, "--version")) {
+			continue;
+		}
+		aci_read_version (&major, &minor);
+
+		saved_cmd = aci_compile_cmd;
+		sbufformat (&cmd, 1, "%s %s", aci_compiler_caches[i].name, aci_compile_cmd);
+		aci_compile_cmd = sbufchars (&cmd);
+		printf ("Does %s %d.%d work with the compiler ", aci_compiler_caches[i].name, major, minor);
+		works = aci_can_compile ("int main () { return 0; }\n", "");
+		printf ("%s\n", aci_noyes[works]);
+		fflush (stdout);
+		aci_compile_cmd = saved_cmd;
+		if (!works) {
+			continue;
+		}
+
+		ac_set_var ("COMPILER_CACHE", aci_compiler_caches[i].name);
+		sbufformat (&cmd, 1, "$(COMPILER_CACHE) %s", aci_compile_cmd);
+		ac_set_var ("CC", sbufchars (&cmd));
+		ac_set_var ("CXX", sbufchars (&cmd));
+
+		vn = aci_varlist_find (&aci_makevars, "GCC_SPLIT_DWARF");
+		if (vn != NULL && vn->chunks.count != 0
+		        && (major < aci_compiler_caches[i].split_dwarf_major
+		            || (major == aci_compiler_caches[i].split_dwarf_major
+		                && minor < aci_compiler_caches[i].split_dwarf_minor))) {
+			printf ("Warning: %s %d.%d does not cache the objects compiled with %s\n",
+			        aci_compiler_caches[i].name, major, minor, "-gsplit-dwarf");
+		}
+		sbuffree (&cmd);
+		return;
+	}
+	printf ("No usable compiler cache has been found\n");
+	ac_set_var ("COMPILER_CACHE", "");
+	sbuffree (&cmd);
+}
+
+
+/* Check the flags needed for profile guided optimization. The objects
+   of pgo-gen/ are instrumented and those of pgo-use/ use the collected
+   profile. PGO_MERGE moves the profile from one tree to the other. */
+static void aci_check_pgo (void)
+{
+	if (aci_compiler_id == aci_cc_clang) {
+		if (ac_has_compiler_flag ("-fprofile-instr-generate", "CLANG_PROFILE_GENERATE")
+		        && aci_has_program ("llvm-profdata", "--version")) {
+			ac_set_var ("PGO_GEN_CFLAGS", "-fprofile-instr-generate=$(CURDIR)/pgo-gen/%m.profraw");
+			ac_set_var ("PGO_USE_CFLAGS", "-fprofile-instr-use=$(CURDIR)/pgo-use/default.profdata");
+			ac_set_var ("PGO_MERGE", "llvm-profdata merge -output=pgo-use/default.profdata pgo-gen/*.profraw");
+			return;
+		}
+	} else if (ac_has_compiler_flag ("-fprofile-generate", "GCC_PROFILE_GENERATE")) {
+		/* The objects without profile would warn otherwise. GCC 9 and
+		   later only; the older ones do not warn. */
+		if (ac_has_compiler_flag ("-Wno-missing-profile", "GCC_NO_MISSING_PROFILE")) {
+			printf ("Does the compiler accept the option -fprofile-use ");
+			if (aci_can_compile_link ("int func(int x) { return x; }\nint main () { return func(42); }\n",
+			                          "-fprofile-use -Wno-missing-profile", NULL, 0)) {
+				ac_set_var ("GCC_PROFILE_USE", "-fprofile-use");
+				printf ("yes\n");
+			} else {
+				printf ("no\n");
+			}
+			fflush (stdout);
+		} else {
+			ac_has_compiler_flag ("-fprofile-use", "GCC_PROFILE_USE");
+		}
+		ac_has_compiler_flag ("-fprofile-partial-training", "GCC_PROFILE_PARTIAL_TRAINING");
+		ac_set_var ("PGO_GEN_CFLAGS", "$(GCC_PROFILE_GENERATE)");
+		ac_set_var ("PGO_USE_CFLAGS", "$(GCC_PROFILE_USE) $(GCC_NO_MISSING_PROFILE) $(GCC_PROFILE_PARTIAL_TRAINING)");
+		/* GCC looks for the profile next to the object file. */
+		ac_set_var ("PGO_MERGE", "$(COPY) pgo-gen/*.gcda pgo-use/");
+		return;
+	}
+
+	ac_set_var ("PGO_GEN_CFLAGS", "");
+	ac_set_var ("PGO_USE_CFLAGS", "");
+	ac_set_var ("PGO_MERGE", "");
+}
+
+
+/* Check the flags for link time optimization. GCC uses the jobserver of
+   make to run the LTO partitions in parallel. Clang uses ThinLTO with a
+   cache in lto/cache. Static libraries with LTO objects need the archiver
+   with the LTO plugin. */
+static void aci_check_lto (void)
+{
+	if (aci_compiler_id == aci_cc_clang) {
+		if (ac_has_compiler_flag ("-flto=thin", "CLANG_THINLTO")) {
+			ac_set_var ("LTO_CFLAGS", "$(CLANG_THINLTO)");
+			if (ac_has_compiler_flag ("-flto=thin -Wl,--thinlto-cache-dir=lto/cache", "CLANG_THINLTO_CACHE")
+			        || ac_has_compiler_flag ("-flto=thin -Wl,-plugin-opt,cache-dir=lto/cache", "CLANG_THINLTO_CACHE")
+			        || ac_has_compiler_flag ("-flto=thin -Wl,-cache_path_lto,lto/cache", "CLANG_THINLTO_CACHE")) {
+				ac_set_var ("LTO_LDFLAGS", "$(CLANG_THINLTO_CACHE)");
+			} else {
+				ac_set_var ("LTO_LDFLAGS", "$(CLANG_THINLTO)");
+			}
+			if (aci_has_program ("llvm-ar", "--version")) {
+				ac_set_var ("LTO_AR", "llvm-ar -cru");
+			} else {
+				ac_set_var ("LTO_AR", "$(AR)");
+			}
+			return;
+		}
+	} else if (ac_has_compiler_flag ("-flto=auto", "GCC_LTO")
+	        || ac_has_compiler_flag ("-flto=jobserver", "GCC_LTO")
+	        || ac_has_compiler_flag ("-flto", "GCC_LTO")) {
+		ac_set_var ("LTO_CFLAGS", "$(GCC_LTO)");
+		ac_set_var ("LTO_LDFLAGS", "$(GCC_LTO)");
+		if (aci_has_program ("gcc-ar", "--version")) {
+			ac_set_var ("LTO_AR", "gcc-ar -cru");
+		} else {
+			ac_set_var ("LTO_AR", "$(AR)");
+		}
+		return;
+	}
+
+	ac_set_var ("LTO_CFLAGS", "");
+	ac_set_var ("LTO_LDFLAGS", "");
+	ac_set_var ("LTO_AR", "$(AR)");
+}
+
+
+/* Check the tools for the post link optimization with BOLT. The programs
+   of bolt/ are linked keeping the relocations so that llvm-bolt can
+   reorder their code using the profile converted by perf2bolt. All the
+   variables stay empty if something is missing. */
+static void aci_check_bolt (void)
+{
+	if (!aci_have_windows
+	        && ac_has_compiler_flag ("-Wl,--emit-relocs", "GCC_EMIT_RELOCS")
+	        && aci_has_program ("llvm-bolt", "--version")
+	        && aci_has_program ("perf2bolt", "--version")) {
+		ac_set_var ("BOLT_LDFLAGS", "$(GCC_EMIT_RELOCS)");
+		ac_set_var ("BOLT", "llvm-bolt");
+		ac_set_var ("PERF2BOLT", "perf2bolt");
+		ac_set_var ("BOLT_FLAGS", "-reorder-blocks=ext-tsp -reorder-functions=hfsort -split-functions -split-all-cold -dyno-stats");
+	} else {
+		ac_set_var ("BOLT_LDFLAGS", "");
+		ac_set_var ("BOLT", "");
+		ac_set_var ("PERF2BOLT", "");
+		ac_set_var ("BOLT_FLAGS", "");
+	}
+}
+
+
+/* Program used to measure the effect of the startup flags. It has unused
+   code and data and two identical functions. */
+static const char aci_startup_test[] =
+	"int unused_data[1024] = { 1 };\n"
+	"int unused1 (int x) { return x * 5 + unused_data[x]; }\n"
+	"int unused2 (int x) { return unused1 (x) * 7; }\n"
+	"int same1 (int x) { return (x ^ 0x5a5a) * 11 + 3; }\n"
+	"int same2 (int x) { return (x ^ 0x5a5a) * 11 + 3; }\n"
+	"int main (int argc, char **argv) { (void)argv; return same1 (argc) + same2 (argc); }\n";
+
+/* Return the size of the file or -1 if it cannot be read. */
+static long aci_file_size (const char *name)
+{
+	FILE *f;
+	long size;
+
+	f = fopen (name, "rb");
+	if (f == NULL) {
+		return -1;
+	}
+	if (fseek (f, 0, SEEK_END) != 0) {
+		fclose (f);
+		return -1;
+	}
+	size = ftell (f);
+	fclose (f);
+	return size;
+}
+
+
+/* Check the flags that reduce the size of the binaries and the work of the
+   dynamic loader at startup. Lazy binding is chosen because it does less
+   work at startup; -Wl,-z,now is left in GCC_BIND_NOW for hardening. */
+static void aci_check_startup_flags (void)
+{
+	const char *aout = aci_have_windows ? "a.exe" : "a.out";
+	const char *ldflags = "$(GCC_GC_SECTIONS) $(GCC_ICF) $(GCC_LD_O1) $(GCC_HASH_STYLE) $(GCC_BIND_LAZY) $(GCC_SORT_COMMON)";
+	sbuf_t flags;
+	long before, after;
 
-	if (n > 0 && n < (ptrdiff_t)(sizeof pfx) + 1) {
-		if (pfx[n - 1] != '/') {
-			pfx[n] = '/';
-			pfx[n + 1] = 0;
-		}
-		ac_set_var ("PREFIX", pfx);
-		strcpy (aci_install_prefix, pfx);
-	} else if (aci_have_windows && !aci_have_cygwin) {
-		if (aci_locate_windows_compiler (aci_compile_cmd, pfx, sizeof pfx) == 0) {
-			strcat (pfx, "local/");
-			ac_set_var ("PREFIX", pfx);
-			strcpy (aci_install_prefix, pfx);
-		} else {
-			ac_set_var ("PREFIX", "/usr/local/");
-			strcpy (aci_install_prefix, "/usr/local/");
+	sbufinit (&flags);
+	sbufcpy (&flags, "-O2");
+	if (ac_has_compiler_flag ("-ffunction-sections -fdata-sections", "GCC_SECTIONS")) {
+		sbufcat (&flags, " -ffunction-sections -fdata-sections");
+		if (ac_has_compiler_flag ("-Wl,--gc-sections", "GCC_GC_SECTIONS")) {
+			sbufcat (&flags, " -Wl,--gc-sections");
 		}
-	} else {
-		ac_set_var ("PREFIX", "/usr/local/");
-		strcpy (aci_install_prefix, "/usr/local/");
 	}
-	if (strchr (aci_install_prefix, ' ') != NULL) {
-		aci_install_prefix_spaces = 1;
+	/* Only gold and lld fold identical code. */
+	if (ac_has_compiler_flag ("-Wl,--icf=all", "GCC_ICF")) {
+		sbufcat (&flags, " -Wl,--icf=all");
+	}
+	if (ac_has_compiler_flag ("-Wl,-O1", "GCC_LD_O1")) {
+		sbufcat (&flags, " -Wl,-O1");
+	}
+	if (ac_has_compiler_flag ("-Wl,--hash-style=gnu", "GCC_HASH_STYLE")) {
+		sbufcat (&flags, " -Wl,--hash-style=gnu");
+	}
+	ac_has_compiler_flag ("-Wl,-z,now", "GCC_BIND_NOW");
+	if (ac_has_compiler_flag ("-Wl,-z,lazy", "GCC_BIND_LAZY")) {
+		sbufcat (&flags, " -Wl,-z,lazy");
+	}
+	if (ac_has_compiler_flag ("-Wl,--sort-common", "GCC_SORT_COMMON")) {
+		sbufcat (&flags, " -Wl,--sort-common");
+	}
+
+	ac_add_var_append ("CFLAGS_OPTIMIZE", "$(GCC_SECTIONS)");
+	ac_add_var_append ("LDFLAGS_OPTIMIZE", ldflags);
+	ac_add_var_append ("SO_LDFLAGS", ldflags);
+
+	/* Report the gain on a small program. */
+	before = after = -1;
+	if (aci_can_compile_link (aci_startup_test, "-O2", NULL, 0)) {
+		before = aci_file_size (aout);
+	}
+	if (aci_can_compile_link (aci_startup_test, sbufchars (&flags), NULL, 0)) {
+		after = aci_file_size (aout);
+	}
+	if (before > 0 && after > 0) {
+		printf ("Size of the test program with the startup flags: %ld bytes instead of %ld (%+ld)\n",
+		        after, before, after - before);
+		fflush (stdout);
 	}
+	sbuffree (&flags);
 }
 
 
@@ -5327,9 +7833,246 @@ static void aci_check_gcc_flags (int prefer_cxx)
 		ac_add_var_append ("LDFLAGS_OPTIMIZE", "$(GCC_O2)");
 	}
 
+	if (!aci_simple) {
+		aci_check_pgo ();
+		aci_check_lto ();
+		aci_check_bolt ();
+		if (aci_optimize_startup) {
+			aci_check_startup_flags ();
+		}
+	}
+
 	/* Signed overflow: We use the same option as Rust: trap on overflow when debugging. Wrap around when optimized. */
 }
 
+/* Write the loader x86-64-loader<ext> that starts the variant of a program
+   for the best of the levels given that the CPU supports. The levels are in
+   increasing order; the lowest one is started if the CPU supports none of
+   them. PELCONF_LOADER_NAME is the name of the program and the variants are
+   looked for in the directory of the loader. */
+static void aci_write_x86_64_loader (const char **levels, const int *accepted, size_t n)
+{
+	FILE *f;
+	size_t i, lowest = n;
+	sbuf_t name, tmpname;
+
+	for (i = 0; i < n && lowest == n; ++i) {
+		if (accepted[i]) lowest = i;
+	}
+	if (lowest == n) {
+		return;
+	}
+
+	sbufinit (&name);
+	sbufinit (&tmpname);
+	sbufformat (&name, 1, "x86-64-loader%s", aci_source_extension);
+	sbufformat (&tmpname, 1, "%s.tmp", sbufchars (&name));
+	f = fopen (sbufchars (&tmpname), "w");
+	if (f == NULL) {
+		fprintf (stderr, "ERROR: could not create the loader %s\n", sbufchars (&name));
+		exit (EXIT_FAILURE);
+	}
+
+	fprintf (f, "/* Automatically generated by the pelconf program, do not edit. */\n"
+	            "/* Build it with -DPELCONF_LOADER_NAME='\"foo\"' to start foo-v2, foo-v3, etc. */\n"
+	            "#ifndef _GNU_SOURCE\n#define _GNU_SOURCE 1\n#endif\n"
+	            "#include <limits.h>\n#include <stdio.h>\n#include <string.h>\n#include <unistd.h>\n\n"
+	            "#ifndef PATH_MAX\n#define PATH_MAX 4096\n#endif\n\n"
+	            "int main (int argc, char **argv)\n{\n"
+	            "\tconst char *level = \"%s\";\n"
+	            "\tchar exe[PATH_MAX], path[PATH_MAX], *slash;\n"
+	            "\tssize_t n;\n\n"
+	            "\t(void) argc;\n"
+	            "\t__builtin_cpu_init ();\n\t", levels[lowest]);
+	for (i = n; i-- > lowest + 1; ) {
+		if (accepted[i]) {
+			fprintf (f, "if (__builtin_cpu_supports (\"x86-64-%s\")) level = \"%s\";\n\telse ",
+			         levels[i], levels[i]);
+		}
+	}
+	fprintf (f, "if (!__builtin_cpu_supports (\"x86-64-%s\")) fputs (\"The CPU does not support x86-64-%s\\n\", stderr);\n\n",
+	         levels[lowest], levels[lowest]);
+	fprintf (f, "\tif (strlen (PELCONF_LOADER_NAME) + strlen (level) + 2 > sizeof exe) return 127;\n"
+	            "\tstrcpy (exe, PELCONF_LOADER_NAME);\n"
+	            "\tstrcat (exe, \"-\");\n"
+	            "\tstrcat (exe, level);\n\n"
+	            "\t/* Look for the variant in the directory of the loader. */\n"
+	            "\tn = readlink (\"/proc/self/exe\", path, sizeof path - 1);\n"
+	            "\tif (n < 0) {\n"
+	            "\t\tstrncpy (path, argv[0], sizeof path - 1);\n"
+	            "\t\tn = sizeof path - 1;\n"
+	            "\t}\n"
+	            "\tpath[n] = 0;\n"
+	            "\tslash = strrchr (path, '/');\n"
+	            "\tif (slash == NULL) {\n"
+	            "\t\texecvp (exe, argv);\n"
+	            "\t} else if (slash - path + strlen (exe) + 2 <= sizeof path) {\n"
+	            "\t\tstrcpy (slash + 1, exe);\n"
+	            "\t\texecv (path, argv);\n"
+	            "\t}\n"
+	            "\tperror (exe);\n"
+	            "\treturn 127;\n}\n");
+	fclose (f);
+
+	if (aci_replace_if_changed (sbufchars (&tmpname), sbufchars (&name))) {
+		printf ("Writing the loader '%s'\n", sbufchars (&name));
+	} else {
+		printf ("'%s' is unchanged\n", sbufchars (&name));
+	}
+	ac_set_var ("X86_64_LOADER", sbufchars (&name));
+	sbuffree (&name);
+	sbuffree (&tmpname);
+}
+
+
+/* Check which x86-64 micro-architecture levels are accepted by the
+   compiler. Each level gets its own X86_64_Vn_CFLAGS makefile variable and
+   X86_64_LEVELS lists them, so that a variant of the program can be built
+   for each one. If __builtin_cpu_supports() knows the levels then also
+   write the loader that starts the best variant. */
+static void aci_check_x86_64_levels (void)
+{
+	static const char *levels[] = { "v2", "v3", "v4" };
+	int accepted[sizeof levels / sizeof levels[0]];
+	size_t i;
+	sbuf_t flag, var, list;
+
+	if (!aci_check_define ("", NULL, "__x86_64__")) {
+		printf ("The micro-architecture levels are only available for x86-64\n");
+		return;
+	}
+
+	sbufinit (&flag);
+	sbufinit (&var);
+	sbufinit (&list);
+
+	for (i = 0; i < sizeof levels / sizeof levels[0]; ++i) {
+		sbufformat (&flag, 1, "-march=x86-64-%s", levels[i]);
+		sbufformat (&var, 1, "X86_64_%s_CFLAGS", levels[i]);
+		aci_make_identifier (sbufchars (&var));
+		accepted[i] = ac_has_compiler_flag (sbufchars (&flag), sbufchars (&var));
+		if (accepted[i]) {
+			if (sbuflen (&list) != 0) sbufcat (&list, " ");
+			sbufcat (&list, levels[i]);
+		}
+	}
+	ac_set_var ("X86_64_LEVELS", sbufchars (&list));
+
+	if (ac_does_compile_and_link ("Can __builtin_cpu_supports() check the x86-64 levels",
+	        "int main (void) {\n"
+	        "    __builtin_cpu_init ();\n"
+	        "    return __builtin_cpu_supports (\"x86-64-v3\") ? 1 : 0;\n"
+	        "}\n",
+	        NULL, NULL, "CPU_SUPPORTS_X86_64_LEVELS")) {
+		aci_write_x86_64_loader (levels, accepted, sizeof levels / sizeof levels[0]);
+	}
+
+	sbuffree (&flag);
+	sbuffree (&var);
+	sbuffree (&list);
+}
+
+
+/* Check the flags that let the calls inside of a shared library go
+   directly to the function instead of through the PLT and the GOT. This
+   forbids replacing the functions of the library with LD_PRELOAD. */
+static void aci_check_so_direct_calls (void)
+{
+	int nointerp, symbolic;
+
+	nointerp = ac_has_compiler_flag ("-fno-semantic-interposition", "GCC_NO_SEMANTIC_INTERPOSITION");
+	ac_has_compiler_flag ("-fno-plt", "GCC_NO_PLT");
+	symbolic = ac_has_compiler_flag ("-Wl,-Bsymbolic-functions", "GCC_BSYMBOLIC_FUNCTIONS");
+
+	ac_add_var_append ("SO_CFLAGS", "$(GCC_NO_SEMANTIC_INTERPOSITION) $(GCC_NO_PLT)");
+	ac_add_var_append ("SO_LDFLAGS", "$(GCC_BSYMBOLIC_FUNCTIONS)");
+
+	/* The full GCC flags already use it for libraries. */
+	if (aci_compiler_id != aci_cc_gcc || aci_simple) {
+		if (aci_varlist_find (&aci_makevars, "GCC_VISIBILITY_INLINES_HIDDEN") == NULL) {
+			ac_has_compiler_flag ("-fvisibility-inlines-hidden", "GCC_VISIBILITY_INLINES_HIDDEN");
+		}
+		ac_add_var_append ("SO_CFLAGS", "$(GCC_VISIBILITY_INLINES_HIDDEN)");
+	}
+
+	ac_add_flag ("NO_INTERPOSITION", "Are the calls inside of shared libraries bound directly",
+	             nointerp && symbolic);
+}
+
+
+/* Memory allocators that can replace malloc. "func" is used to check that
+   the library links. "ext" lists the extended functions that are checked
+   as well. */
+static const struct {
+	const char *name, *package, *lib, *header, *func;
+	const char *ext[4];
+} aci_allocators[] = {
+	{ "jemalloc", "jemalloc", "jemalloc", "jemalloc/jemalloc.h", "malloc_stats_print",
+	  { "mallocx", "sdallocx", "nallocx", NULL } },
+	{ "tcmalloc", "libtcmalloc", "tcmalloc", "gperftools/tcmalloc.h", "tc_malloc",
+	  { "tc_free_sized", "tc_malloc_size", NULL, NULL } },
+	{ "mimalloc", "mimalloc", "mimalloc", "mimalloc.h", "mi_malloc",
+	  { "mi_free_size", "mi_heap_new", "mi_heap_malloc", "mi_heap_destroy" } }
+};
+
+
+/* Link with the allocator "name". This is done at the end of ac_init() so
+   that the library comes after all the other libraries in EXTRALIBS and
+   also replaces their calls to malloc when linking statically. */
+static void aci_check_allocator (const char *name)
+{
+	size_t i, j;
+	int found;
+	sbuf_t cflags, libs, tag;
+	const char *lflags;
+	int verbatim;
+
+	for (i = 0; i < sizeof aci_allocators / sizeof aci_allocators[0]; ++i) {
+		if (strcmp (name, aci_allocators[i].name) == 0) {
+			break;
+		}
+	}
+	if (i == sizeof aci_allocators / sizeof aci_allocators[0]) {
+		ac_msg_error ("unknown allocator given with --with-allocator");
+	}
+
+	sbufinit (&cflags);
+	sbufinit (&libs);
+	sbufinit (&tag);
+	sbufcpy (&tag, aci_allocators[i].name);
+	aci_make_identifier (sbufchars (&tag));
+
+	/* The package name of pkg-config is not always the name of the library. */
+	if (ac_has_pkg_config ()
+	        && ac_pkg_config_query (aci_allocators[i].package, &cflags, &libs) == 0) {
+		found = ac_has_func_pkg_config_tag (aci_allocators[i].header, NULL,
+		        aci_allocators[i].func, aci_allocators[i].package, sbufchars (&tag));
+		lflags = sbufchars (&libs);
+		verbatim = 1;
+	} else {
+		found = ac_has_func_lib_tag (aci_allocators[i].header, NULL,
+		        aci_allocators[i].func, aci_allocators[i].lib, 0, sbufchars (&tag));
+		lflags = aci_allocators[i].lib;
+		verbatim = 0;
+	}
+	if (!found) {
+		ac_msg_error ("the allocator given with --with-allocator cannot be used");
+	}
+
+	for (j = 0; j < sizeof aci_allocators[i].ext / sizeof aci_allocators[i].ext[0]
+	        && aci_allocators[i].ext[j] != NULL; ++j) {
+		sbufcpy (&tag, aci_allocators[i].ext[j]);
+		aci_make_identifier (sbufchars (&tag));
+		ac_has_func_lib_tag (aci_allocators[i].header, sbufchars (&cflags),
+		        aci_allocators[i].ext[j], lflags, verbatim, sbufchars (&tag));
+	}
+
+	sbuffree (&cflags);
+	sbuffree (&libs);
+	sbuffree (&tag);
+}
+
+
 /* Check for the availability of Tiny CC flags. */
 static void aci_check_tinyc_flags (void)
 {
@@ -5498,6 +8241,13 @@ void aci_check_clang_flags (int prefer_cxx)
 	ac_add_var_append ("CFLAGS_OPTIMIZE", "$(GCC_O2) $(GCC_OMITFRAMEPOINTER) -DNDEBUG");
 	ac_add_var_append ("LDFLAGS_DEBUG", "$(GCC_STACK_PROTECTION) $(GCC_TRAPV) $(GCC_NON_CALL_EXCEPTION)");
 	ac_add_var_append ("LDFLAGS_OPTIMIZE", "$(GCC_O2)");
+
+	aci_check_pgo ();
+	aci_check_lto ();
+	aci_check_bolt ();
+	if (aci_optimize_startup) {
+		aci_check_startup_flags ();
+	}
 }
 
 
@@ -5509,6 +8259,11 @@ void ac_init (const char *extension, int argc, char **argv, int latest_c_version
 	const char *pfx;
 	int use_dos_conventions = 0;
 	const char *cp;
+	const char *manifest;
+	const char *linker;
+	const char *cache_name;
+	const char *allocator;
+	int compiler_cache;
 	static char compiler_name[FILENAME_MAX];
 	char wall[200];
 	sbuf_t config_string;
@@ -5516,12 +8271,17 @@ void ac_init (const char *extension, int argc, char **argv, int latest_c_version
 
 	remove ("configure.log");
 
+	if (argc > 0) {
+		aci_progname = argv[0];
+	}
+
 	sbufinit (&aci_include_dirs);
 	sbufinit (&aci_lib_dirs);
 	sbufinit (&aci_extra_cflags);
 	sbufinit (&aci_extra_ldflags);
 	sbufinit (&aci_additional_libs);
 	sbufinit (&aci_testing_flags);
+	sbufinit (&aci_link_testing_flags);
 	sbufinit (&aci_common_headers);
 
 	sbufinit (&config_string);
@@ -5666,6 +8426,8 @@ void ac_init (const char *extension, int argc, char **argv, int latest_c_version
 	aci_keep    = aci_has_option (&argc, argv, aci_keep_name);
 	aci_simple  = aci_has_option (&argc, argv, aci_simple_name);
 	aci_static  = aci_has_option (&argc, argv, aci_static_name);
+	aci_optimize_startup = aci_has_option (&argc, argv, aci_optimize_startup_name);
+	aci_no_run = aci_has_option (&argc, argv, aci_no_run_name);
 
 	if (aci_has_option (&argc, argv, aci_stdver)) {
 		aci_use_stdver = 1;
@@ -5680,6 +8442,12 @@ void ac_init (const char *extension, int argc, char **argv, int latest_c_version
 	ac_set_var ("LDFLAGS", "$(EXTRA_LDFLAGS) $(EXTRA_LIB_DIRS)");
 	ac_set_var ("SO_LDFLAGS", "$(EXTRA_LDFLAGS) $(EXTRA_LIB_DIRS)");
 
+	/* Select the linker first, so that the other tests use it. */
+	linker = aci_has_optval (&argc, argv, aci_linker_name);
+	if (aci_compiler_id == aci_cc_gcc || aci_compiler_id == aci_cc_clang) {
+		aci_check_fast_ld (linker);
+	}
+
 	switch (aci_compiler_id) {
 	case aci_cc_gcc:
 		aci_check_gcc_flags (prefer_cxx);
@@ -5711,6 +8479,16 @@ void ac_init (const char *extension, int argc, char **argv, int latest_c_version
 		;
 	}
 
+	if (aci_has_option (&argc, argv, aci_x86_64_levels_name)
+	        && (aci_compiler_id == aci_cc_gcc || aci_compiler_id == aci_cc_clang)) {
+		aci_check_x86_64_levels ();
+	}
+
+	if (aci_has_option (&argc, argv, aci_so_direct_calls_name)
+	        && (aci_compiler_id == aci_cc_gcc || aci_compiler_id == aci_cc_clang)) {
+		aci_check_so_direct_calls ();
+	}
+
 
 	if (aci_has_option (&argc, argv, aci_dos_name)) {
 		use_dos_conventions = 1;
@@ -5737,9 +8515,18 @@ void ac_init (const char *extension, int argc, char **argv, int latest_c_version
 		strcpy (aci_makevars_file, cp);
 	}
 
+	manifest = aci_has_optval (&argc, argv, aci_manifest_name);
+	allocator = aci_has_optval (&argc, argv, aci_allocator_name);
+	aci_target_cpu_topology = aci_has_optval (&argc, argv, aci_target_cpu_topology_name);
+	compiler_cache = aci_has_option (&argc, argv, aci_compiler_cache_name);
+	cache_name = aci_has_optval (&argc, argv, aci_compiler_cache_name);
+
 	ac_set_var ("OUTPUT_OPTION", aci_exe_cmd);
 	ac_set_var ("CC", aci_compile_cmd);
 	ac_set_var ("CXX", aci_compile_cmd);
+	if (compiler_cache || cache_name != NULL) {
+		aci_check_compiler_cache (cache_name);
+	}
 
 	aci_get_wall (aci_compile_cmd, wall);
 	ac_set_var ("WALL", wall);
@@ -5753,6 +8540,7 @@ void ac_init (const char *extension, int argc, char **argv, int latest_c_version
 /*    aci_check_werror (); */
 	aci_check_stdint ();
 	aci_check_endian_cross (use_dos_conventions ? ".obj" : ".o");
+	aci_check_cross_compiling ();
 	aci_check_misc_once ();
 
 	int has_abiname = (aci_varlist_find(&aci_features, "ABINAME") != NULL);
@@ -5781,22 +8569,70 @@ void ac_init (const char *extension, int argc, char **argv, int latest_c_version
 
 	aci_varlist_set (&aci_features, "CONFIGURATION", sbufchars (&config_string));
 	sbuffree (&config_string);
+
+	if (allocator) {
+		aci_check_allocator (allocator);
+	}
+
+	if (manifest) {
+		ac_run_manifest (manifest);
+	}
 }
 
 
 
+/* Replace the file "name" with "tmpname" unless both have the same
+   contents. Keeping the old file preserves its time stamp and nothing that
+   depends on it is rebuilt. Return nonzero if the file was replaced. */
+static int aci_replace_if_changed (const char *tmpname, const char *name)
+{
+	FILE *f1, *f2;
+	int c1, c2, same = 0;
+
+	f1 = fopen (tmpname, "rb");
+	f2 = fopen (name, "rb");
+	if (f1 && f2) {
+		do {
+			c1 = getc (f1);
+			c2 = getc (f2);
+		} while (c1 == c2 && c1 != EOF);
+		same = c1 == c2;
+	}
+	if (f1) fclose (f1);
+	if (f2) fclose (f2);
+
+	if (same) {
+		remove (tmpname);
+		return 0;
+	}
+
+	remove (name);
+	if (rename (tmpname, name) != 0) {
+		fprintf (stderr, "ERROR: could not rename %s to %s\n", tmpname, name);
+		exit (EXIT_FAILURE);
+	}
+	return 1;
+}
+
+
 /* Write out the configuration file to "config_name". Prefix the
-   configuration macros with "feature_pfx".
+   configuration macros with "feature_pfx". If the contents did not change
+   the file is not touched.
 */
 void ac_config_out (const char *config_name, const char *feature_pfx)
 {
 	FILE *f;
 	char config_name_upper[FILENAME_MAX], *wp;
 	const char *rp;
+	sbuf_t tmpname;
 
 	printf ("Writing configuration file '%s'\n", config_name);
 
-	f = fopen (config_name, "w");
+	strncpy (aci_config_name, config_name, sizeof aci_config_name - 1);
+	sbufinit (&tmpname);
+	sbufformat (&tmpname, 1, "%s.tmp", config_name);
+
+	f = fopen (sbufchars (&tmpname), "w");
 	if (f == NULL) {
 		fprintf (stderr, "ERROR: could not create the configuration header %s\n",
 		         config_name);
@@ -5829,6 +8665,11 @@ void ac_config_out (const char *config_name, const char *feature_pfx)
 
 	fprintf (f, "#endif\n");
 	fclose (f);
+
+	if (!aci_replace_if_changed (sbufchars (&tmpname), config_name)) {
+		printf ("'%s' is unchanged\n", config_name);
+	}
+	sbuffree (&tmpname);
 }
 
 
@@ -5887,9 +8728,408 @@ void ac_edit_makefile (const char *make_in, const char *make_out)
 			fprintf (fw, "%s\n", sbufchars (&sb));
 		}
 	}
-
-	fclose (fr);
+
+	fclose (fr);
+	fclose (fw);
+	sbuffree (&sb);
+}
+
+
+/* Append to sb the make text "s" converted to the ninja syntax. References
+   to variables become ${NAME}, the automatic variables become $in and $out
+   and any other dollar is escaped. Return nonzero if "s" uses make
+   functions, which ninja does not have. */
+static int aci_ninja_cat (sbuf_t *sb, const char *s)
+{
+	const char *close;
+	int bad = 0;
+
+	while (*s) {
+		if (*s == '\\' && s[1] == '\n') {
+			sbufcat (sb, " ");
+			s += 2;
+			continue;
+		}
+		if (*s == '\n') {
+			sbufcat (sb, " ");
+			++s;
+			continue;
+		}
+		if (*s != '$') {
+			sbufncat (sb, s, 1);
+			++s;
+			continue;
+		}
+		switch (s[1]) {
+		case '(':
+		case '{':
+			close = strchr (s + 2, s[1] == '(' ? ')' : '}');
+			if (close && strcspn (s + 2, " \t$") < (size_t)(close - s - 2)) {
+				bad = 1;
+			}
+			if (close) {
+				sbufcat (sb, "${");
+				sbufncat (sb, s + 2, close - s - 2);
+				sbufcat (sb, "}");
+				s = close + 1;
+				continue;
+			}
+			break;
+		case '@':
+			sbufcat (sb, "$out");
+			s += 2;
+			continue;
+		case '<': case '^': case '&':
+			sbufcat (sb, "$in");
+			s += 2;
+			continue;
+		case '*':
+			if (s[2] == '*') {
+				sbufcat (sb, "$in");
+				s += 3;
+				continue;
+			}
+			break;
+		case '$':
+			s += 1;
+			break;
+		}
+		sbufcat (sb, "$$");
+		++s;
+	}
+	return bad;
+}
+
+
+/* Write a path of a build statement escaping the characters that are
+   special for ninja. */
+static void aci_ninja_path (FILE *f, const char *s)
+{
+	for (; *s; ++s) {
+		if (*s == '$' || *s == ' ' || *s == ':') {
+			putc ('$', f);
+		}
+		putc (*s, f);
+	}
+}
+
+
+/* Write the variable vn after the variables of vl that it references.
+   Ninja expands the variables when they are defined, not when they are
+   used as make does. */
+static void aci_ninja_dump_var (aci_varlist_t *vl, aci_varnode_t *vn,
+                                aci_strlist_t *done, FILE *f)
+{
+	char **beg, **end;
+	const char *cp, *close;
+	aci_varnode_t *ref;
+	sbuf_t sb;
+
+	if (aci_strlist_find (done, vn->name)) {
+		return;
+	}
+	aci_strlist_add (done, vn->name, 0);
+
+	sbufinit (&sb);
+	beg = aci_strlist_begin (&vn->chunks);
+	end = aci_strlist_end (&vn->chunks);
+	for (; beg != end; ++beg) {
+		cp = *beg;
+		while ((cp = strchr (cp, '$')) != NULL) {
+			if ((cp[1] == '(' || cp[1] == '{') &&
+			        (close = strchr (cp + 2, cp[1] == '(' ? ')' : '}')) != NULL) {
+				sbufncpy (&sb, cp + 2, close - cp - 2);
+				ref = aci_varlist_find (vl, sbufchars (&sb));
+				if (ref) {
+					aci_ninja_dump_var (vl, ref, done, f);
+				}
+				cp = close;
+			} else if (cp[1] != 0) {
+				++cp;
+			}
+			++cp;
+		}
+	}
+
+	sbufcpy (&sb, vn->name);
+	sbufcat (&sb, " =");
+	beg = aci_strlist_begin (&vn->chunks);
+	for (; beg != end; ++beg) {
+		sbufcat (&sb, " ");
+		if (aci_ninja_cat (&sb, *beg)) {
+			sbufformat (&sb, 1, "# %s uses make functions and is left empty", vn->name);
+			break;
+		}
+	}
+	fprintf (f, "%s\n", sbufchars (&sb));
+	sbuffree (&sb);
+}
+
+
+/* Add to vl the simple variable assignments of the makefile "fname". The
+   lines that cannot be translated are written as comments to f. */
+static void aci_ninja_read_makevars (aci_varlist_t *vl, const char *fname, FILE *f)
+{
+	FILE *fr;
+	sbuf_t line, name;
+	const char *cp, *sow;
+
+	fr = fopen (fname, "r");
+	if (fr == NULL) {
+		return;
+	}
+
+	sbufinit (&line);
+	sbufinit (&name);
+	while (sbufgets (&line, fr) == 0 || sbuflen (&line) != 0) {
+		cp = aci_eatws (sbufchars (&line));
+		if (*cp == 0 || *cp == '#') {
+			continue;
+		}
+
+		sow = cp;
+		while (isalnum (*cp) || *cp == '_' || *cp == '.' || *cp == '-') ++cp;
+		sbufncpy (&name, sow, cp - sow);
+		cp = aci_eatws (cp);
+
+		if (sbuflen (&name) == 0 || sbufchars (&line)[0] == '\t') {
+			fprintf (f, "# not translated from %s: %s\n", fname, sbufchars (&line));
+		} else if (*cp == '=') {
+			aci_varlist_set (vl, sbufchars (&name), aci_eatws (cp + 1));
+		} else if (strncmp (cp, ":=", 2) == 0) {
+			aci_varlist_set (vl, sbufchars (&name), aci_eatws (cp + 2));
+		} else if (strncmp (cp, "::=", 3) == 0) {
+			aci_varlist_set (vl, sbufchars (&name), aci_eatws (cp + 3));
+		} else if (strncmp (cp, "+=", 2) == 0) {
+			aci_varlist_cat (vl, sbufchars (&name), aci_eatws (cp + 2), 0);
+		} else if (strncmp (cp, "?=", 2) == 0) {
+			if (aci_varlist_find (vl, sbufchars (&name)) == NULL) {
+				aci_varlist_set (vl, sbufchars (&name), aci_eatws (cp + 2));
+			}
+		} else {
+			fprintf (f, "# not translated from %s: %s\n", fname, sbufchars (&line));
+		}
+	}
+	sbuffree (&line);
+	sbuffree (&name);
+	fclose (fr);
+}
+
+
+/* The object directories of makefile.in and the flags that each one adds
+   when compiling and when linking. The first one is for the objects
+   without directory. */
+static const struct {
+	const char *dir, *cflags, *ldflags, *ar;
+} aci_ninja_dirs[] = {
+	{ NULL, "", "", "${AR}" },
+	{ "debug", "${CFLAGS_DEBUG}", "${LDFLAGS_DEBUG} -L${PREFIX}debug/lib", "${AR}" },
+	{ "optimized", "${CFLAGS_OPTIMIZE}", "${LDFLAGS_OPTIMIZE}", "${AR}" },
+	{ "pgo-gen", "${CFLAGS_OPTIMIZE} ${PGO_GEN_CFLAGS}", "${LDFLAGS_OPTIMIZE} ${PGO_GEN_CFLAGS}", "${AR}" },
+	{ "pgo-use", "${CFLAGS_OPTIMIZE} ${PGO_USE_CFLAGS}", "${LDFLAGS_OPTIMIZE} ${PGO_USE_CFLAGS}", "${AR}" },
+	{ "lto", "${CFLAGS_OPTIMIZE} ${LTO_CFLAGS}", "${LDFLAGS_OPTIMIZE} ${LTO_LDFLAGS}", "${LTO_AR}" },
+	{ "bolt", "${CFLAGS_OPTIMIZE}", "${LDFLAGS_OPTIMIZE} ${BOLT_LDFLAGS}", "${AR}" }
+};
+
+/* The ABIs given to mkdeps --abi that makefile.in knows. The first one is
+   for the objects without ABI. */
+static const struct {
+	const char *abi, *cflags, *ldflags;
+} aci_ninja_abis[] = {
+	{ NULL, "${CFLAGS}", "${CFLAGS} ${LDFLAGS}" },
+	{ "pic", "${SO_CFLAGS}", "${CFLAGS} ${LDFLAGS}" },
+	{ "pie", "${PIE_CFLAGS}", "${PIE_CFLAGS} ${PIE_LDFLAGS}" },
+	{ "v2", "${CFLAGS} ${X86_64_V2_CFLAGS}", "${CFLAGS} ${LDFLAGS} ${X86_64_V2_CFLAGS}" },
+	{ "v3", "${CFLAGS} ${X86_64_V3_CFLAGS}", "${CFLAGS} ${LDFLAGS} ${X86_64_V3_CFLAGS}" },
+	{ "v4", "${CFLAGS} ${X86_64_V4_CFLAGS}", "${CFLAGS} ${LDFLAGS} ${X86_64_V4_CFLAGS}" }
+};
+
+
+/* Put in sb the name of a ninja rule as mkdeps --ninja expects it: kind,
+   the object directory and the ABI joined by underscores, as
+   cc_optimized_pic or link_pgo_gen. */
+static void aci_ninja_rule_name (sbuf_t *sb, const char *kind, const char *dir, const char *abi)
+{
+	const char *parts[2], *cp;
+	size_t i;
+
+	sbufcpy (sb, kind);
+	parts[0] = dir;
+	parts[1] = abi;
+	for (i = 0; i < 2; ++i) {
+		if (parts[i] == NULL) {
+			continue;
+		}
+		sbufcat (sb, "_");
+		for (cp = parts[i]; *cp; ++cp) {
+			sbufncat (sb, isalnum ((unsigned char) *cp) ? cp : "_", 1);
+		}
+	}
+}
+
+
+/* Write the ninja build file "ninja_out". It contains the same variables
+   as the makefile, the rules that correspond to the pattern rules of
+   makefile.in and a rule to run the configuration again. The contents of
+   "ninja_in", which should have the build statements written by
+   mkdeps --ninja, are appended. */
+void ac_edit_ninja (const char *ninja_in, const char *ninja_out)
+{
+	FILE *fr = NULL, *fw;
+	sbuf_t sb, tmpname;
+	aci_varlist_t vars;
+	aci_varnode_t *vn;
+	aci_strlist_t done;
+	int depfiles;
+	size_t d, a;
+	char **beg, **end, *exe_cmd;
+
+	printf ("Generating file '%s'", ninja_out);
+	if (ninja_in) {
+		printf (" from '%s'", ninja_in);
+		fr = fopen (ninja_in, "r");
+		if (fr == NULL) {
+			fprintf (stderr, "\nerror: could not open the ninja template %s. "
+			         "It is written by mkdeps --ninja %s\n", ninja_in, ninja_in);
+			exit (EXIT_FAILURE);
+		}
+	}
+	printf ("\n");
+
+	sbufinit (&sb);
+	sbufinit (&tmpname);
+	sbufformat (&tmpname, 1, "%s.tmp", ninja_out);
+	fw = fopen (sbufchars (&tmpname), "wb");
+	if (fw == NULL) {
+		fprintf (stderr, "ERROR: could not create the ninja file %s\n", ninja_out);
+		exit (EXIT_FAILURE);
+	}
+
+	fprintf (fw, "# Automatically generated by the pelconf program, do not edit.\n");
+	if (ninja_in) {
+		fprintf (fw, "# This file was generated from %s\n", ninja_in);
+	}
+	fprintf (fw, "ninja_required_version = 1.3\n\n");
+
+	/* The makefile includes the compiler specific file after the variables,
+	   so its assignments take precedence. */
+	aci_varlist_init (&vars);
+	for (vn = aci_makevars.root; vn; vn = vn->next) {
+		beg = aci_strlist_begin (&vn->chunks);
+		end = aci_strlist_end (&vn->chunks);
+		for (; beg != end; ++beg) {
+			aci_varlist_cat (&vars, vn->name, *beg, 0);
+		}
+	}
+	sbuftrunc (&sb, 0);
+	beg = aci_strlist_begin (&aci_pkg_config_packs);
+	end = aci_strlist_end (&aci_pkg_config_packs);
+	for (; beg != end; ++beg) {
+		aci_varlist_cat (&vars, "PKG_CONFIG_PACKS", *beg, 0);
+	}
+	if (aci_warn_makevars) {
+		aci_varlist_set (&vars, "AR", "ar -cru");
+	} else {
+		aci_ninja_read_makevars (&vars, aci_makevars_file, fw);
+	}
+
+	/* These only make sense inside of a rule. */
+	aci_strlist_init (&done);
+	aci_strlist_add (&done, "OUTPUT_OPTION", 0);
+	aci_strlist_add (&done, "ALLDEPS", 0);
+	for (vn = vars.root; vn; vn = vn->next) {
+		aci_ninja_dump_var (&vars, vn, &done, fw);
+	}
+	aci_strlist_destroy (&done);
+	aci_varlist_destroy (&vars);
+
+	depfiles = aci_compiler_id == aci_cc_gcc || aci_compiler_id == aci_cc_clang
+	           || aci_compiler_id == aci_cc_tinyc;
+
+	/* One compilation and one link rule for each object directory and ABI,
+	   like the pattern rules of makefile.in. */
+	fprintf (fw, "\n\n# Rules. Set incflags, ldflags and libs in the build statements.\n");
+	sbuftrunc (&sb, 0);
+	aci_ninja_cat (&sb, aci_exe_cmd);
+	exe_cmd = aci_strsave (sbufchars (&sb));
+	for (d = 0; d < sizeof aci_ninja_dirs / sizeof aci_ninja_dirs[0]; ++d) {
+		for (a = 0; a < sizeof aci_ninja_abis / sizeof aci_ninja_abis[0]; ++a) {
+			aci_ninja_rule_name (&sb, "cc", aci_ninja_dirs[d].dir, aci_ninja_abis[a].abi);
+			fprintf (fw, "rule %s\n", sbufchars (&sb));
+			fprintf (fw, "  command = ${CC} ${WALL} %s %s $incflags -I${PREFIX}include %s-o $out -c $in\n",
+			         aci_ninja_abis[a].cflags, aci_ninja_dirs[d].cflags,
+			         depfiles ? "-MMD -MF $out.d " : "");
+			if (depfiles) {
+				fprintf (fw, "  depfile = $out.d\n  deps = gcc\n");
+			}
+			fprintf (fw, "  description = CC $out\n\n");
+
+			aci_ninja_rule_name (&sb, "link", aci_ninja_dirs[d].dir, aci_ninja_abis[a].abi);
+			fprintf (fw, "rule %s\n", sbufchars (&sb));
+			fprintf (fw, "  command = ${CC} ${WALL} %s %s %s $in $ldflags -L${PREFIX}lib $libs ${EXTRALIBS}\n",
+			         aci_ninja_abis[a].ldflags, aci_ninja_dirs[d].ldflags, exe_cmd);
+			fprintf (fw, "  description = LINK $out\n\n");
+		}
+
+		aci_ninja_rule_name (&sb, "so", aci_ninja_dirs[d].dir, NULL);
+		fprintf (fw, "rule %s\n", sbufchars (&sb));
+		fprintf (fw, "  command = ${CC} ${WALL} ${SO_LDFLAGS} %s %s $in $ldflags -L${PREFIX}lib $libs ${EXTRALIBS}\n",
+		         aci_ninja_dirs[d].ldflags, exe_cmd);
+		fprintf (fw, "  description = LINK $out\n\n");
+
+		aci_ninja_rule_name (&sb, "ar", aci_ninja_dirs[d].dir, NULL);
+		fprintf (fw, "rule %s\n  command = %s $out $in\n  description = AR $out\n\n",
+		         sbufchars (&sb), aci_ninja_dirs[d].ar);
+	}
+	fprintf (fw, "rule link_static\n");
+	fprintf (fw, "  command = ${CC} -static ${WALL} ${CFLAGS} ${LDFLAGS} ${LDFLAGS_OPTIMIZE} %s $in $ldflags -L${PREFIX}lib $libs ${EXTRALIBS}\n",
+	         exe_cmd);
+	fprintf (fw, "  description = LINK $out\n\n");
+	aci_strfree (exe_cmd);
+
+	/* Run the configuration again when its inputs change. The outputs that
+	   did not change keep their time stamp. */
+	vn = aci_varlist_find (&aci_features, "CONFIGURATION");
+	fprintf (fw, "rule configure\n  command = %s", aci_progname);
+	if (vn) {
+		beg = aci_strlist_begin (&vn->chunks);
+		end = aci_strlist_end (&vn->chunks);
+		for (; beg != end; ++beg) {
+			sbuftrunc (&sb, 0);
+			aci_ninja_cat (&sb, *beg);
+			fprintf (fw, " %s", sbufchars (&sb));
+		}
+	}
+	fprintf (fw, "\n  generator = 1\n  restat = 1\n  description = CONFIGURE\n\n");
+
+	fprintf (fw, "build ");
+	aci_ninja_path (fw, ninja_out);
+	if (aci_config_name[0]) {
+		fprintf (fw, " ");
+		aci_ninja_path (fw, aci_config_name);
+	}
+	fprintf (fw, ": configure |");
+	if (ninja_in) {
+		fprintf (fw, " ");
+		aci_ninja_path (fw, ninja_in);
+	}
+	if (!aci_warn_makevars) {
+		fprintf (fw, " ");
+		aci_ninja_path (fw, aci_makevars_file);
+	}
+	fprintf (fw, "\n");
+
+	if (fr) {
+		fprintf (fw, "\n\n# Start of the input file %s\n\n", ninja_in);
+		while (sbufgets (&sb, fr) == 0 || sbuflen (&sb) != 0) {
+			fprintf (fw, "%s\n", sbufchars (&sb));
+		}
+		fclose (fr);
+	}
 	fclose (fw);
+
+	aci_replace_if_changed (sbufchars (&tmpname), ninja_out);
+	sbuffree (&tmpname);
 	sbuffree (&sb);
 }
 
@@ -5958,6 +9198,8 @@ void ac_create_pc_file (const char *libname, const char *desc)
 
 
 
+static void aci_pkg_cache_free (void);
+
 /* Finish everything. */
 void ac_finish (void)
 {
@@ -5967,6 +9209,7 @@ void ac_finish (void)
 	sbuffree (&aci_extra_ldflags);
 	sbuffree (&aci_additional_libs);
 	sbuffree (&aci_testing_flags);
+	sbuffree (&aci_link_testing_flags);
 
 	aci_strlist_destroy (&aci_tdefs);
 	aci_strlist_destroy (&aci_pkg_config_packs);
@@ -5986,6 +9229,7 @@ void ac_finish (void)
 	sbuffree (&aci_common_headers);
 
 	aci_flag_list_free (aci_flags_root);
+	aci_pkg_cache_free ();
 
 
 	if (aci_warn_makevars) {
@@ -5995,62 +9239,198 @@ void ac_finish (void)
 }
 
 
-/* See if pkg-config is available. */
+static int aci_pkg_config = 0;
+static int aci_pkg_config_checked = 0;
+
+
+/* See if pkg-config is available. The answer is remembered for the rest of
+   the run. */
 int ac_has_pkg_config (void)
 {
-	return aci_run_silent ("pkg-config --help") == 0;
+	if (!aci_pkg_config_checked) {
+		aci_pkg_config = aci_run_silent ("pkg-config --version") == 0;
+		aci_pkg_config_checked = 1;
+	}
+	return aci_pkg_config;
 }
 
 
 typedef enum { pkgconf_cflags, pkgconf_libs } pkgconf_flags;
 
 
-/* Get the flags as given by pkg-config. */
-int ac_pkg_config_flags (const char *s, char *buf, size_t n, pkgconf_flags what)
+/* The answer of pkg-config for one package. */
+typedef struct aci_pkg_cache_s {
+	char *package;
+	char *cflags, *libs;
+	/* Exit status of pkg-config. */
+	int err;
+	struct aci_pkg_cache_s *next;
+} aci_pkg_cache_t;
+
+/* The packages that have been queried during this run. */
+static aci_pkg_cache_t *aci_pkg_cache = NULL;
+
+
+static void aci_pkg_cache_free (void)
 {
-	 sbuf_t sb;
-	 int    err;
+	aci_pkg_cache_t *pc;
 
-	 *buf = 0;
-	 sbufinit (&sb);
+	while (aci_pkg_cache) {
+		pc = aci_pkg_cache->next;
+		aci_strfree (aci_pkg_cache->package);
+		aci_strfree (aci_pkg_cache->cflags);
+		aci_strfree (aci_pkg_cache->libs);
+		free (aci_pkg_cache);
+		aci_pkg_cache = pc;
+	}
+}
 
-	 sbufcpy (&sb, "pkg-config ");
 
-	 if (what == pkgconf_cflags) {
-		  sbufcat (&sb, "--cflags");
-	 } else if (what == pkgconf_libs) {
-		  sbufcat (&sb, "--libs");
-		  if (aci_have_windows) {
-			   sbufcat (&sb, " --static");
-		  }
-	 }
+/* Does the flag given by pkg-config belong to the compilation step? Return
+   0 for the linking step, 1 for the compilation step and 2 for both, as
+   with -pthread, -fopenmp or -m32. Set *takes_arg if the following word is
+   the argument of the flag. */
+static int aci_is_compile_flag (const char *flag, size_t len, int *takes_arg)
+{
+	static const char *with_arg[] = { "-isystem", "-idirafter", "-include", "-iquote" };
+	size_t i;
+
+	*takes_arg = 0;
+	for (i = 0; i < sizeof with_arg / sizeof with_arg[0]; ++i) {
+		if (len == strlen (with_arg[i]) && strncmp (flag, with_arg[i], len) == 0) {
+			*takes_arg = 1;
+			return 1;
+		}
+	}
+	if (len < 2 || flag[0] != '-') {
+		return 0;
+	}
+	switch (flag[1]) {
+	case 'I': case 'D': case 'U':
+		return 1;
+	case 'f': case 'm':
+		return 2;
+	case 'p':
+		return len == 8 && strncmp (flag, "-pthread", 8) == 0 ? 2 : 0;
+	case 'W':
+		return strncmp (flag, "-Wl,", 4) != 0;
+	case 's':
+		return strncmp (flag, "-std=", 5) == 0;
+	default:
+		return 0;
+	}
+}
 
-	 sbufcat (&sb, " ");
-	 sbufcat (&sb, s);
 
-	 err = aci_run_silent (sbufchars (&sb));
+/* Query pkg-config once for both the compilation and the linking flags of
+   "package" and split them. The result is cached for the rest of the run. */
+static aci_pkg_cache_t * aci_pkg_config_query (const char *package)
+{
+	aci_pkg_cache_t *pc;
+	sbuf_t sb, out, cflags, libs;
+	const char *sow, *eow;
+	int takes_arg = 0, prev_takes_arg, step;
+	FILE *f;
 
-	 if (err == 0) {
-		  FILE *f = fopen (aci_stdout_dummy, "r");
-		  if (f) {
-			   size_t count = fread (buf, 1, n - 1, f);
-			   if (count > 0 && buf[count - 1] == '\n') {
-					buf[count - 1] = 0;
-			   } else {
-					buf[count] = 0;
-			   }
+	for (pc = aci_pkg_cache; pc != NULL; pc = pc->next) {
+		if (strcmp (pc->package, package) == 0) {
+			return pc;
+		}
+	}
 
-			   fclose (f);
-		  }
-	 }
+	sbufinit (&sb);
+	sbufinit (&out);
+	sbufinit (&cflags);
+	sbufinit (&libs);
+
+	pc = (aci_pkg_cache_t*) aci_xmalloc (sizeof(aci_pkg_cache_t));
+	pc->package = aci_strsave (package);
+
+	sbufcpy (&sb, "pkg-config --cflags --libs ");
+	if (aci_have_windows) {
+		sbufcat (&sb, "--static ");
+	}
+	sbufcat (&sb, package);
+	pc->err = aci_run_silent (sbufchars (&sb));
 
-	 sbuffree (&sb);
-	 return err;
+	if (pc->err == 0) {
+		f = fopen (aci_stdout_dummy, "r");
+		if (f) {
+			while (sbufgets (&sb, f) == 0 || sbuflen (&sb) != 0) {
+				sbufcat (&out, " ");
+				sbufcat (&out, sbufchars (&sb));
+			}
+			fclose (f);
+		}
+	}
+
+	sow = aci_eatws (sbufchars (&out));
+	while (*sow) {
+		eow = aci_eatnws (sow);
+		prev_takes_arg = takes_arg;
+		step = prev_takes_arg ? 1 : aci_is_compile_flag (sow, eow - sow, &takes_arg);
+		if (prev_takes_arg) takes_arg = 0;
+		if (step != 0) {
+			if (sbuflen (&cflags) != 0) sbufcat (&cflags, " ");
+			sbufncat (&cflags, sow, eow - sow);
+		}
+		if (step != 1) {
+			if (sbuflen (&libs) != 0) sbufcat (&libs, " ");
+			sbufncat (&libs, sow, eow - sow);
+		}
+		sow = aci_eatws (eow);
+	}
+
+	pc->cflags = aci_strsave (sbufchars (&cflags));
+	pc->libs = aci_strsave (sbufchars (&libs));
+	pc->next = aci_pkg_cache;
+	aci_pkg_cache = pc;
+
+	sbuffree (&sb);
+	sbuffree (&out);
+	sbuffree (&cflags);
+	sbuffree (&libs);
+	return pc;
 }
 
 
-static int aci_pkg_config = 0;
-static int aci_pkg_config_checked = 0;
+/* Get the compilation and linking flags of "package" as given by
+   pkg-config. Either cflags or libs may be NULL. Return 0 on success. */
+int ac_pkg_config_query (const char *package, sbuf_t *cflags, sbuf_t *libs)
+{
+	aci_pkg_cache_t *pc = aci_pkg_config_query (package);
+
+	if (cflags) {
+		sbufcpy (cflags, pc->err == 0 ? pc->cflags : "");
+	}
+	if (libs) {
+		sbufcpy (libs, pc->err == 0 ? pc->libs : "");
+	}
+	return pc->err;
+}
+
+
+/* Get the flags as given by pkg-config. The flags are truncated if they do
+   not fit in buf. */
+int ac_pkg_config_flags (const char *s, char *buf, size_t n, pkgconf_flags what)
+{
+	aci_pkg_cache_t *pc = aci_pkg_config_query (s);
+	const char *flags = what == pkgconf_cflags ? pc->cflags : pc->libs;
+	size_t len = strlen (flags);
+
+	if (n == 0) {
+		return pc->err;
+	}
+	*buf = 0;
+	if (pc->err == 0) {
+		if (len >= n) {
+			len = n - 1;
+		}
+		memcpy (buf, flags, len);
+		buf[len] = 0;
+	}
+	return pc->err;
+}
 
 
 
@@ -6062,22 +9442,18 @@ int ac_has_func_pkg_config_tag (const char *includes,
         const char *tag)
 {
 	int res = 0;
-	sbuf_t sb;
-	char pcflags[500], libs[500];
+	sbuf_t sb, pcflags, libs;
 	FILE *logfile;
 
-	if (!aci_pkg_config_checked) {
-		aci_pkg_config = ac_has_pkg_config ();
-		aci_pkg_config_checked = 1;
-	}
+	sbufinit (&pcflags);
+	sbufinit (&libs);
 
-	if (aci_pkg_config &&
-	           ac_pkg_config_flags (package, pcflags, sizeof pcflags, pkgconf_cflags) == 0 &&
-	           ac_pkg_config_flags (package, libs, sizeof libs, pkgconf_libs) == 0) {
+	if (ac_has_pkg_config () &&
+	           ac_pkg_config_query (package, &pcflags, &libs) == 0) {
 		sbufinit (&sb);
 		sbufcpy (&sb, cflags ? cflags : "");
-		sbufcat (&sb, " ");    sbufcat (&sb, pcflags);
-		res = ac_has_func_lib_tag (includes, sbufchars (&sb), func, libs, 1, tag);
+		sbufcat (&sb, " ");    sbufcat (&sb, sbufchars (&pcflags));
+		res = ac_has_func_lib_tag (includes, sbufchars (&sb), func, sbufchars (&libs), 1, tag);
 		logfile = fopen ("configure.log", "a");
 		if (logfile) {
 			fprintf (logfile, "\nFound package %s in pkg-config: %d\n", package, res);
@@ -6096,6 +9472,8 @@ int ac_has_func_pkg_config_tag (const char *includes,
 		}
 #endif
 	}
+	sbuffree (&pcflags);
+	sbuffree (&libs);
 	return res;
 }
 
@@ -6115,22 +9493,18 @@ int ac_has_member_pkg_config_tag (const char *includes, const char *cflags,
                                   const char *tag)
 {
 	int res = 0;
-	sbuf_t sb;
-	char pcflags[500], libs[500];
+	sbuf_t sb, pcflags, libs;
 	FILE *logfile;
 
-	if (!aci_pkg_config_checked) {
-		aci_pkg_config = ac_has_pkg_config ();
-		aci_pkg_config_checked = 1;
-	}
+	sbufinit (&pcflags);
+	sbufinit (&libs);
 
-	if (aci_pkg_config &&
-	           ac_pkg_config_flags (package, pcflags, sizeof pcflags, pkgconf_cflags) == 0 &&
-	           ac_pkg_config_flags (package, libs, sizeof libs, pkgconf_libs) == 0) {
+	if (ac_has_pkg_config () &&
+	           ac_pkg_config_query (package, &pcflags, &libs) == 0) {
 		sbufinit (&sb);
 		sbufcpy (&sb, cflags ? cflags : "");
-		sbufcat (&sb, " ");    sbufcat (&sb, pcflags);
-		res = ac_has_member_lib_tag (includes, sbufchars (&sb), func, libs, 1, tag);
+		sbufcat (&sb, " ");    sbufcat (&sb, sbufchars (&pcflags));
+		res = ac_has_member_lib_tag (includes, sbufchars (&sb), func, sbufchars (&libs), 1, tag);
 
 		logfile = fopen ("configure.log", "a");
 		if (logfile) {
@@ -6149,6 +9523,8 @@ int ac_has_member_pkg_config_tag (const char *includes, const char *cflags,
 		}
 #endif
 	}
+	sbuffree (&pcflags);
+	sbuffree (&libs);
 	return res;
 }
 
@@ -6164,3 +9540,462 @@ int ac_has_member_pkg_config (const char *includes, const char *cflags,
 
 
 
+
+
+
+/* Probe manifests.
+
+   A manifest lists probes declaratively so that the set of checks can be
+   changed without recompiling the driver. Each probe starts with a line
+   [TAG] followed by key = value lines. The key "kind" selects the check and
+   the keys "after" and "unless" list the tags that must have passed or
+   failed before the probe is run. The probes are run in dependency order.
+*/
+
+/* The states of a manifest probe. */
+enum { aci_probe_pending, aci_probe_done, aci_probe_skipped };
+
+/* A probe read from a manifest. */
+typedef struct {
+	/* The tag that will be defined in config.h. */
+	char *tag;
+	/* The key = value pairs given for the probe. */
+	aci_varlist_t params;
+	/* Line of the manifest where the probe starts. */
+	int line;
+	/* One of the aci_probe_xxx states. */
+	int state;
+	/* Did the probe pass? */
+	int result;
+} aci_probe_t;
+
+
+/* The probes of a manifest. */
+typedef struct {
+	size_t count, capacity;
+	aci_probe_t *probes;
+} aci_probe_list_t;
+
+
+static void aci_probe_list_init (aci_probe_list_t *pl)
+{
+	pl->count = 0;
+	pl->capacity = 0;
+	pl->probes = NULL;
+}
+
+
+static void aci_probe_list_destroy (aci_probe_list_t *pl)
+{
+	size_t i;
+
+	for (i = 0; i < pl->count; ++i) {
+		aci_strfree (pl->probes[i].tag);
+		aci_varlist_destroy (&pl->probes[i].params);
+	}
+	free (pl->probes);
+	aci_probe_list_init (pl);
+}
+
+
+/* Append a new probe with the given tag and return it. */
+static aci_probe_t * aci_probe_list_add (aci_probe_list_t *pl, const char *tag,
+                                         int line)
+{
+	aci_probe_t *p;
+
+	if (pl->count == pl->capacity) {
+		size_t ncap = pl->capacity * 2 + 20;
+		aci_probe_t *np = (aci_probe_t*) aci_xmalloc (sizeof(aci_probe_t) * ncap);
+		if (pl->count != 0) {
+			memcpy (np, pl->probes, sizeof(aci_probe_t) * pl->count);
+		}
+		free (pl->probes);
+		pl->probes = np;
+		pl->capacity = ncap;
+	}
+
+	p = &pl->probes[pl->count++];
+	p->tag = aci_strsave (tag);
+	aci_varlist_init (&p->params);
+	p->line = line;
+	p->state = aci_probe_pending;
+	p->result = 0;
+	return p;
+}
+
+
+/* Find the probe with the given tag. Return NULL if not found. */
+static aci_probe_t * aci_probe_list_find (aci_probe_list_t *pl, const char *tag)
+{
+	size_t i;
+
+	for (i = 0; i < pl->count; ++i) {
+		if (strcmp (pl->probes[i].tag, tag) == 0) {
+			return &pl->probes[i];
+		}
+	}
+	return NULL;
+}
+
+
+/* Return the value of the parameter "key" of the probe or NULL if it has
+   not been given. */
+static const char * aci_probe_param (aci_probe_t *p, const char *key)
+{
+	aci_varnode_t *vn = aci_varlist_find (&p->params, key);
+
+	if (vn == NULL || vn->chunks.count == 0) {
+		return NULL;
+	}
+	return vn->chunks.strs[0];
+}
+
+
+/* Read the manifest "fname" into pl. Lines ending with a backslash are
+   continued in the next line, which is useful for the source code of the
+   compile and link probes. Return 0 on success. */
+static int aci_read_manifest (const char *fname, aci_probe_list_t *pl)
+{
+	FILE *f;
+	sbuf_t line, key, value;
+	aci_probe_t *cur = NULL;
+	const char *start, *end, *eq;
+	int lineno = 0, err = 0, continued = 0;
+
+	f = fopen (fname, "r");
+	if (f == NULL) {
+		fprintf (stderr, "ERROR: could not open the manifest %s\n", fname);
+		return -1;
+	}
+
+	sbufinit (&line);
+	sbufinit (&key);
+	sbufinit (&value);
+
+	while (sbufgets (&line, f) == 0 || sbuflen (&line) != 0) {
+		++lineno;
+		start = sbufchars (&line);
+		end = aci_last_non_blank (start, start + sbuflen (&line));
+
+		if (continued) {
+			continued = end > start && end[-1] == '\\';
+			if (continued) --end;
+			sbufcat (&value, "\n");
+			sbufncat (&value, start, end - start);
+			if (!continued) {
+				aci_varlist_set (&cur->params, sbufchars (&key), sbufchars (&value));
+			}
+			continue;
+		}
+
+		start = aci_eatws (start);
+		if (start >= end || *start == '#' || *start == ';') {
+			continue;
+		}
+
+		if (*start == '[') {
+			if (end[-1] != ']') {
+				fprintf (stderr, "%s:%d: missing ']'\n", fname, lineno);
+				err = -1;
+				break;
+			}
+			sbufncpy (&key, start + 1, end - start - 2);
+			aci_make_identifier (sbufchars (&key));
+			if (aci_probe_list_find (pl, sbufchars (&key)) != NULL) {
+				fprintf (stderr, "%s:%d: the probe %s is defined twice\n",
+				         fname, lineno, sbufchars (&key));
+				err = -1;
+				break;
+			}
+			cur = aci_probe_list_add (pl, sbufchars (&key), lineno);
+			continue;
+		}
+
+		eq = strchr (start, '=');
+		if (eq == NULL || eq >= end || cur == NULL) {
+			fprintf (stderr, "%s:%d: expected [TAG] or key = value\n",
+			         fname, lineno);
+			err = -1;
+			break;
+		}
+
+		sbufncpy (&key, start, aci_last_non_blank (start, eq) - start);
+		start = aci_eatws (eq + 1);
+		if (start > end) start = end;
+		continued = end > start && end[-1] == '\\';
+		if (continued) --end;
+		sbufncpy (&value, start, end - start);
+		if (!continued) {
+			aci_varlist_set (&cur->params, sbufchars (&key), sbufchars (&value));
+		}
+	}
+
+	if (continued && err == 0) {
+		aci_varlist_set (&cur->params, sbufchars (&key), sbufchars (&value));
+	}
+
+	sbuffree (&line);
+	sbuffree (&key);
+	sbuffree (&value);
+	fclose (f);
+	return err;
+}
+
+
+/* Return 1 if the tag has been checked and passed, 0 if it has been checked
+   and failed and -1 if it has not been checked by the regular functions. */
+static int aci_flag_list_state (const aci_flag_item_t *fi, const char *tag)
+{
+	int state = -1;
+	sbuf_t sb;
+
+	sbufinit (&sb);
+	sbufformat (&sb, 1, "%sHAVE_%s", aci_macro_prefix, tag);
+
+	while (fi) {
+		if (strcmp (fi->tag, sbufchars (&sb)) == 0) {
+			if (fi->passed) {
+				state = 1;
+				break;
+			}
+			state = 0;
+		}
+		fi = fi->next;
+	}
+	sbuffree (&sb);
+	return state;
+}
+
+
+/* Check the dependencies listed in "deps". Return 1 if all of them are
+   known and have the wanted result, 0 if one of them has the wrong result
+   and -1 if we must wait for a probe that has not been run yet. The name
+   of the offending dependency is stored in "why". */
+static int aci_probe_deps_ready (aci_probe_list_t *pl, const char *deps,
+                                 int wanted, sbuf_t *why)
+{
+	const char *sow, *eow;
+	aci_probe_t *dp;
+	sbuf_t tag;
+	int res = 1, state;
+
+	if (deps == NULL) {
+		return 1;
+	}
+
+	sbufinit (&tag);
+	sow = aci_eatws (deps);
+	while (*sow && res == 1) {
+		for (eow = sow; *eow && *eow != ',' && !isspace(*eow); ++eow) ;
+		sbufncpy (&tag, sow, eow - sow);
+		aci_make_identifier (sbufchars (&tag));
+
+		dp = aci_probe_list_find (pl, sbufchars (&tag));
+		if (dp != NULL) {
+			state = dp->state == aci_probe_pending ? -1 : dp->result;
+		} else {
+			state = aci_flag_list_state (aci_flags_root, sbufchars (&tag));
+			if (state < 0) {
+				/* Neither in the manifest nor checked before: not available. */
+				state = 0;
+			}
+		}
+
+		if (state < 0) {
+			res = -1;
+		} else if (state != wanted) {
+			res = 0;
+			sbufcpy (why, sbufchars (&tag));
+		}
+		if (*eow == ',') ++eow;
+		sow = aci_eatws (eow);
+	}
+	sbuffree (&tag);
+	return res;
+}
+
+
+/* Build a key that identifies the check performed by the probe. Two
+   probes with the same key will give the same result. */
+static void aci_probe_signature (aci_probe_t *p, sbuf_t *sb)
+{
+	static const char *keys[] = {
+		"kind", "includes", "cflags", "func", "libs", "pkg", "struct",
+		"member", "type", "src", "flag"
+	};
+	const char *val;
+	size_t i;
+
+	sbuftrunc (sb, 0);
+	for (i = 0; i < sizeof keys / sizeof keys[0]; ++i) {
+		val = aci_probe_param (p, keys[i]);
+		sbufformat (sb, 0, "%s=%s\001", keys[i], val ? val : "");
+	}
+}
+
+
+/* Run a single probe of the manifest. Return the result of the check. */
+static int aci_run_probe (aci_probe_t *p, const char *fname)
+{
+	const char *kind = aci_probe_param (p, "kind");
+	const char *includes = aci_probe_param (p, "includes");
+	const char *cflags = aci_probe_param (p, "cflags");
+	const char *func = aci_probe_param (p, "func");
+	const char *libs = aci_probe_param (p, "libs");
+	const char *pkg = aci_probe_param (p, "pkg");
+	const char *src = aci_probe_param (p, "src");
+	const char *comment = aci_probe_param (p, "comment");
+	const char *flag = aci_probe_param (p, "flag");
+	const char *makevar = aci_probe_param (p, "makevar");
+	int result = 0;
+
+	if (comment == NULL) {
+		comment = p->tag;
+	}
+
+	if (kind == NULL) {
+		fprintf (stderr, "%s:%d: no kind given for the probe %s\n",
+		         fname, p->line, p->tag);
+		ac_msg_error ("invalid manifest");
+	} else if (strcmp (kind, "header") == 0) {
+		result = ac_has_headers_tag (includes, cflags, p->tag);
+	} else if (strcmp (kind, "proto") == 0 && func) {
+		result = ac_has_proto_tag (includes, cflags, func, p->tag);
+	} else if (strcmp (kind, "func") == 0 && func && pkg) {
+		result = ac_has_func_pkg_config_tag (includes, cflags, func, pkg, p->tag);
+	} else if (strcmp (kind, "func") == 0 && func) {
+		result = ac_has_func_lib_tag (includes, cflags, func, libs, 0, p->tag);
+	} else if (strcmp (kind, "member") == 0 && aci_probe_param (p, "struct")
+	                                       && aci_probe_param (p, "member")) {
+		result = ac_has_member_tag (includes, cflags, aci_probe_param (p, "struct"),
+		                            aci_probe_param (p, "member"), p->tag);
+	} else if (strcmp (kind, "type") == 0 && aci_probe_param (p, "type")) {
+		result = ac_has_type_tag (includes, cflags, aci_probe_param (p, "type"),
+		                          p->tag);
+	} else if (strcmp (kind, "compile") == 0 && src) {
+		result = ac_does_compile (comment, src, cflags, p->tag);
+	} else if (strcmp (kind, "link") == 0 && src) {
+		result = ac_does_compile_and_link (comment, src, cflags, libs, p->tag);
+	} else if (strcmp (kind, "flag") == 0 && flag) {
+		result = ac_has_compiler_flag (flag, makevar ? makevar : p->tag);
+	} else {
+		fprintf (stderr, "%s:%d: unknown kind or missing parameters for the "
+		         "probe %s\n", fname, p->line, p->tag);
+		ac_msg_error ("invalid manifest");
+	}
+	return result;
+}
+
+
+/* Read the manifest "fname" and run its probes. A probe is run once all
+   the probes that it depends on have been run. Probes whose dependencies
+   are not satisfied are skipped and their tag is left undefined. Probes that
+   perform exactly the same check as one already run reuse its result.
+   Return the number of probes that passed. */
+int ac_run_manifest (const char *fname)
+{
+	aci_probe_list_t pl;
+	aci_probe_t *p, *q;
+	size_t i, j, remaining;
+	int progress, ready, passed = 0;
+	sbuf_t why, sig, other;
+	FILE *logfile;
+
+	aci_probe_list_init (&pl);
+	if (aci_read_manifest (fname, &pl) != 0) {
+		aci_probe_list_destroy (&pl);
+		ac_msg_error ("could not read the probe manifest");
+	}
+
+	printf ("Running the probes of the manifest %s\n", fname);
+	fflush (stdout);
+
+	sbufinit (&why);
+	sbufinit (&sig);
+	sbufinit (&other);
+
+	remaining = pl.count;
+	while (remaining != 0) {
+		progress = 0;
+		for (i = 0; i < pl.count; ++i) {
+			p = &pl.probes[i];
+			if (p->state != aci_probe_pending) {
+				continue;
+			}
+
+			ready = aci_probe_deps_ready (&pl, aci_probe_param (p, "after"), 1, &why);
+			if (ready == 1) {
+				ready = aci_probe_deps_ready (&pl, aci_probe_param (p, "unless"), 0, &why);
+			}
+			if (ready < 0) {
+				continue;
+			}
+
+			progress = 1;
+			--remaining;
+
+			if (ready == 0) {
+				p->state = aci_probe_skipped;
+				p->result = 0;
+				sbufformat (&sig, 1, "%s skipped because of %s", p->tag, sbufchars (&why));
+				ac_add_flag (p->tag, sbufchars (&sig), 0);
+				printf ("%s\n", sbufchars (&sig));
+				fflush (stdout);
+				continue;
+			}
+
+			/* Look for an identical probe that has already been run. */
+			aci_probe_signature (p, &sig);
+			for (j = 0; j < i; ++j) {
+				q = &pl.probes[j];
+				if (q->state == aci_probe_done) {
+					aci_probe_signature (q, &other);
+					if (strcmp (sbufchars (&sig), sbufchars (&other)) == 0) {
+						break;
+					}
+				}
+			}
+
+			if (j < i) {
+				p->result = q->result;
+				sbufformat (&other, 1, "Same check as %s", q->tag);
+				if (strcmp (aci_probe_param (p, "kind"), "flag") != 0) {
+					ac_add_flag (p->tag, sbufchars (&other), p->result);
+				} else if (p->result) {
+					const char *mv = aci_probe_param (p, "makevar");
+					ac_set_var (mv ? mv : p->tag, aci_probe_param (p, "flag"));
+				}
+				printf ("%s (cached): %s\n", sbufchars (&other), aci_noyes[p->result]);
+				fflush (stdout);
+			} else {
+				p->result = aci_run_probe (p, fname);
+			}
+			p->state = aci_probe_done;
+			passed += p->result;
+		}
+
+		if (!progress) {
+			for (i = 0; i < pl.count; ++i) {
+				if (pl.probes[i].state == aci_probe_pending) {
+					fprintf (stderr, "%s:%d: the probe %s is part of a dependency cycle\n",
+					         fname, pl.probes[i].line, pl.probes[i].tag);
+				}
+			}
+			ac_msg_error ("cyclic dependencies in the probe manifest");
+		}
+	}
+
+	logfile = fopen ("configure.log", "a");
+	if (logfile) {
+		fprintf (logfile, "\nManifest %s: %d of %d probes passed\n", fname,
+		         passed, (int)pl.count);
+		fclose (logfile);
+	}
+
+	sbuffree (&why);
+	sbuffree (&sig);
+	sbuffree (&other);
+	aci_probe_list_destroy (&pl);
+	return passed;
+}